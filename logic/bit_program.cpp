@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "bit_program.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace logic {
+    size_t BitProgram::Append(Instruction instruction) {
+        _instructions.push_back(instruction);
+        return _instructions.size() - 1;
+    }
+
+    uint32_t BitProgram::AppendOperands(const uint32_t slots[ ], size_t count) {
+        uint32_t first = _operands.size();
+        _operands.insert(end(_operands), slots, slots + count);
+        return first;
+    }
+
+    size_t BitProgram::GetSize() const {
+        return _instructions.size();
+    }
+
+    auto BitProgram::GetInstructions() const -> const vector<Instruction>& {
+        return _instructions;
+    }
+
+    void BitProgram::Evaluate(const uint64_t variables[ ], uint64_t slots[ ]) const {
+        LOGIC_STATS_COUNT(stats::BITSLICED_EVALUATIONS, 1);
+        auto s = slots;
+        for (const auto& ins: _instructions) {
+            switch (ins.opcode) {
+            case OP_CONST:       *s = ins.a ? ~uint64_t(0) : 0;        break;
+            case OP_VARIABLE:    *s = variables[ins.a];                break;
+            case OP_NOT:         *s = ~slots[ins.a];                   break;
+            case OP_AND:         *s = slots[ins.a] & slots[ins.b];     break;
+            case OP_OR:          *s = slots[ins.a] | slots[ins.b];     break;
+            case OP_XOR:         *s = slots[ins.a] ^ slots[ins.b];     break;
+            case OP_IMPLICATION: *s = ~slots[ins.a] | slots[ins.b];    break;
+            case OP_EQUIVALENCE: *s = ~(slots[ins.a] ^ slots[ins.b]);  break;
+
+            case OP_NARY_AND:
+                *s = ~uint64_t(0);
+                for (auto i = ins.a; i < ins.a + ins.b; i++)
+                    *s &= slots[_operands[i]];
+                break;
+
+            case OP_NARY_OR:
+                *s = 0;
+                for (auto i = ins.a; i < ins.a + ins.b; i++)
+                    *s |= slots[_operands[i]];
+                break;
+
+            case OP_NARY_XOR:
+                *s = 0;
+                for (auto i = ins.a; i < ins.a + ins.b; i++)
+                    *s ^= slots[_operands[i]];
+                break;
+            }
+            s++;
+        }
+    }
+}
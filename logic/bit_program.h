@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace logic {
+    // A flat, register-based form of an expression that evaluates 64 assignments at once:
+    // bit `k` of every word belongs to the `k`-th assignment.
+    class BitProgram {
+    public:
+        enum Opcode: uint8_t {
+            OP_CONST,
+            OP_VARIABLE,
+            OP_NOT,
+            OP_AND,
+            OP_OR,
+            OP_XOR,
+            OP_IMPLICATION,
+            OP_EQUIVALENCE,
+            OP_NARY_AND,
+            OP_NARY_OR,
+            OP_NARY_XOR,
+        };
+
+        // For n-ary opcodes, `a` is the position of the first operand in the operand list and
+        // `b` is the number of operands.
+        struct Instruction {
+            Opcode opcode;
+            uint32_t a, b;
+        };
+
+        size_t Append(Instruction);
+        uint32_t AppendOperands(const uint32_t slots[ ], size_t count);
+        size_t GetSize() const;
+        auto GetInstructions() const -> const std::vector<Instruction>&;
+
+        // `slots` must have room for `GetSize()` words; slot `i` receives the value of the
+        // `i`-th instruction. `variables[j]` holds the values of the `j`-th variable.
+        void Evaluate(const uint64_t variables[ ], uint64_t slots[ ]) const;
+
+    private:
+        std::vector<Instruction> _instructions;
+        std::vector<uint32_t> _operands;
+    };
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "checker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "dependency_visitor.h"
+#include "exception.h"
+#include "program_visitor.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    const uint64_t LANE_PATTERNS[ ] = {
+        0xAAAAAAAAAAAAAAAA,
+        0xCCCCCCCCCCCCCCCC,
+        0xF0F0F0F0F0F0F0F0,
+        0xFF00FF00FF00FF00,
+        0xFFFF0000FFFF0000,
+        0xFFFFFFFF00000000,
+    };
+    const uint64_t WORDS_PER_CHUNK = 1024;
+    const uint64_t NOT_FOUND = UINT64_MAX;
+
+    // Returns the index of the first assignment (variable `i` is bit `n - i - 1` of it) on which
+    // the results of the programs differ, or `NOT_FOUND`. A null `b` stands for constant truth.
+    uint64_t FindMismatch(size_t n, const BitProgram& a, const BitProgram* b) {
+        size_t low = min<size_t>(n, 6);
+        uint64_t valid = n >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << n)) - 1;
+        uint64_t words = uint64_t(1) << (n - low);
+        atomic<uint64_t> next(0), found(NOT_FOUND);
+
+        auto worker = [&]( ) {
+            vector<uint64_t> vars(n), slotsA(a.GetSize()), slotsB(b ? b->GetSize() : 0);
+            // Lanes enumerate the last `low` variables; the word index enumerates the rest.
+            for (size_t i = 0; i < low; i++)
+                vars[n - i - 1] = LANE_PATTERNS[i];
+            for (;;) {
+                uint64_t first = next.fetch_add(WORDS_PER_CHUNK);
+                if (first >= words)
+                    return;
+                uint64_t last = min(first + WORDS_PER_CHUNK, words);
+                for (uint64_t w = first; w < last; w++) {
+                    if (w << low > found.load(memory_order_relaxed))
+                        return;
+                    for (size_t i = low; i < n; i++)
+                        vars[n - i - 1] = (w >> (i - low)) & 0x1 ? ~uint64_t(0) : 0;
+                    a.Evaluate(vars.data(), slotsA.data());
+                    uint64_t diff = slotsA.back();
+                    if (b) {
+                        b->Evaluate(vars.data(), slotsB.data());
+                        diff ^= slotsB.back();
+                    } else
+                        diff = ~diff;
+                    diff &= valid;
+                    if (diff) {
+                        uint64_t index = w << low;
+                        while (!(diff & 0x1)) {
+                            diff >>= 1;
+                            index++;
+                        }
+                        uint64_t prev = found.load();
+                        while (index < prev && !found.compare_exchange_weak(prev, index)) { }
+                        return;
+                    }
+                }
+            }
+        };
+
+        size_t threadCount = min<uint64_t>(
+            max(thread::hardware_concurrency(), 1u),
+            (words + WORDS_PER_CHUNK - 1) / WORDS_PER_CHUNK
+        );
+        vector<thread> threads;
+        for (size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& t: threads)
+            t.join();
+        return found;
+    }
+
+    vector<string> CollectVariables(const Expression& a, const Expression* b) {
+        DependencyVisitor visitor;
+        a.Traverse(&visitor);
+        if (b)
+            b->Traverse(&visitor);
+        auto deps = visitor.GetNames();
+        if (deps.size() >= 64)
+            throw TooManyVariablesError(deps.size());
+        return deps;
+    }
+
+    BitProgram Compile(const Expression& e, const vector<string>& vars) {
+        ProgramVisitor visitor(vars);
+        e.Traverse(&visitor);
+        return visitor.GetResult();
+    }
+
+    bool Check(const Expression& a, const Expression* b, map<string, bool>* counterexample) {
+        LOGIC_STATS_TIME(stats::CHECKER);
+        auto vars = CollectVariables(a, b);
+        auto programA = Compile(a, vars);
+        uint64_t index;
+        if (b) {
+            auto programB = Compile(*b, vars);
+            index = FindMismatch(vars.size(), programA, &programB);
+        } else
+            index = FindMismatch(vars.size(), programA, nullptr);
+        if (index == NOT_FOUND)
+            return true;
+        if (counterexample) {
+            counterexample->clear();
+            for (size_t i = 0; i < vars.size(); i++)
+                counterexample->emplace(vars[i], index >> (vars.size() - i - 1) & 0x1);
+        }
+        return false;
+    }
+}
+
+namespace logic {
+    bool CheckTautology(const Expression& e, map<string, bool>* counterexample) {
+        return Check(e, nullptr, counterexample);
+    }
+
+    bool CheckEquivalent(const Expression& a, const Expression& b,
+        map<string, bool>* counterexample) {
+        return Check(a, &b, counterexample);
+    }
+}
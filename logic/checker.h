@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include "expression.h"
+
+namespace logic {
+    // Both functions search the whole assignment space (in parallel, 64 assignments per word)
+    // and stop as soon as the answer is known. If the answer is negative and `counterexample`
+    // is not null, it receives the first (in lexicographic order) falsifying assignment.
+    bool CheckTautology(const Expression&, std::map<std::string, bool>* counterexample = nullptr);
+    bool CheckEquivalent(
+        const Expression&, const Expression&, std::map<std::string, bool>* counterexample = nullptr
+    );
+}
@@ -18,17 +18,44 @@
  */
 
 #include "dependency_visitor.h"
+#include <algorithm>
 #include "expression.h"
 
 using namespace std;
 
 namespace logic {
     void DependencyVisitor::Visit(const Expression* e) {
-        if (auto var = dynamic_cast<const Variable*>(e))
-            _dependencies.insert(var->GetName());
+        if (auto var = dynamic_cast<const Variable*>(e)) {
+            if (!_symbols)
+                _symbols = &var->GetSymbolTable();
+            else if (_symbols != &var->GetSymbolTable()) {
+                _foreign.insert(var->GetName());
+                return;
+            }
+            auto symbol = var->GetSymbol();
+            if (symbol >= _dependencies.size())
+                _dependencies.resize(symbol + 1);
+            _dependencies[symbol] = true;
+        }
     }
 
-    set<string> DependencyVisitor::GetResult() {
-        return move(_dependencies);
+    auto DependencyVisitor::GetResult() const -> const vector<bool>& {
+        return _dependencies;
+    }
+
+    auto DependencyVisitor::GetSymbolTable() const -> const SymbolTable* {
+        return _symbols;
+    }
+
+    auto DependencyVisitor::GetNames() const -> vector<string> {
+        if (!_symbols)
+            return { };
+        auto result = _symbols->GetNames(_dependencies);
+        if (!_foreign.empty()) {
+            result.insert(end(result), begin(_foreign), end(_foreign));
+            sort(begin(result), end(result));
+            result.erase(unique(begin(result), end(result)), end(result));
+        }
+        return result;
     }
 }
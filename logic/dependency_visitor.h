@@ -21,15 +21,25 @@
 
 #include <set>
 #include <string>
+#include <vector>
+#include "symbol_table.h"
 #include "visitor.h"
 
 namespace logic {
+    // Collects the symbols of the variables met.
     class DependencyVisitor: public Visitor {
     public:
         void Visit(const Expression*);
-        auto GetResult() -> std::set<std::string>;
+        // Bit `i` is set iff symbol `i` of `GetSymbolTable()` occurs.
+        auto GetResult() const -> const std::vector<bool>&;
+        // The table of the first variable met, `nullptr` if there were none.
+        auto GetSymbolTable() const -> const SymbolTable*;
+        // Names of all variables met (including those from other tables), sorted.
+        auto GetNames() const -> std::vector<std::string>;
 
     private:
-        std::set<std::string> _dependencies;
+        std::vector<bool> _dependencies;
+        const SymbolTable* _symbols = nullptr;
+        std::set<std::string> _foreign;
     };
 }
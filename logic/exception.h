@@ -20,6 +20,7 @@
 #pragma once
 
 #include <stdexcept>
+#include <string>
 
 namespace logic {
     /*abstract*/ class Exception: public std::logic_error {
@@ -35,4 +36,31 @@ namespace logic {
     private:
         std::string _name;
     };
+
+    class TooManyVariablesError: public Exception {
+    public:
+        explicit TooManyVariablesError(size_t count):
+            Exception("Too many variables (" + std::to_string(count) + ')'), _count(count) { }
+
+    private:
+        size_t _count;
+    };
+
+    class ForeignVariableError: public Exception {
+    public:
+        explicit ForeignVariableError(const std::string& name):
+            Exception("Variable '" + name + "' is from another symbol table"), _name(name) { }
+
+    private:
+        std::string _name;
+    };
+
+    class ProfileFormatError: public Exception {
+    public:
+        explicit ProfileFormatError(size_t line):
+            Exception("Malformed profile (line " + std::to_string(line) + ')'), _line(line) { }
+
+    private:
+        size_t _line;
+    };
 }
@@ -20,10 +20,38 @@
 #include "expression.h"
 #include <sstream>
 #include "exception.h"
+#include "stats.h"
 #include "../make_unique.h"
 
 using namespace std;
 
+namespace {
+    using namespace logic;
+
+    // Returns -1 if the expression is not a constant.
+    int GetConstValue(const Expression& e) {
+        auto c = dynamic_cast<const Const*>(&e);
+        return c ? c->GetValue() : -1;
+    }
+
+    auto Negate(unique_ptr<Expression>&& x) -> unique_ptr<Expression> {
+        auto value = GetConstValue(*x);
+        if (value >= 0)
+            return make_unique<Const>(!value);
+        return make_unique<Not>(move(x));
+    }
+
+    // `empty` is the value of a chain without operands.
+    template <typename T>
+    auto Join(vector<unique_ptr<Expression>>&& operands, bool empty) -> unique_ptr<Expression> {
+        if (operands.empty())
+            return make_unique<Const>(empty);
+        if (operands.size() == 1)
+            return move(operands[0]);
+        return make_unique<T>(move(operands));
+    }
+}
+
 namespace logic {
     Const::Const(bool value): _value(value) { }
 
@@ -31,10 +59,15 @@ namespace logic {
         return _value;
     }
 
-    bool Const::Evaluate(const map<string, bool>&) const {
+    bool Const::Evaluate(const Context&) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return _value;
     }
 
+    auto Const::Specialize(const Context&) const -> unique_ptr<Expression> {
+        return make_unique<Const>(_value);
+    }
+
     void Const::Traverse(Visitor* visitor) const {
         visitor->Visit(this);
     }
@@ -55,19 +88,37 @@ namespace logic {
         os << char(_value + '0');
     }
 
-    Variable::Variable(const string& name): _name(name) { }
+    Variable::Variable(const string& name):
+        _symbol(SymbolTable::GetDefault().Intern(name)), _symbols(&SymbolTable::GetDefault()) { }
 
-    Variable::Variable(string&& name): _name(move(name)) { }
+    Variable::Variable(SymbolId symbol, const SymbolTable& symbols):
+        _symbol(symbol), _symbols(&symbols) { }
 
-    string Variable::GetName() const {
-        return _name;
+    auto Variable::GetName() const -> const string& {
+        return _symbols->GetName(_symbol);
     }
 
-    bool Variable::Evaluate(const map<string, bool>& context) const {
-        auto it = context.find(_name);
-        if (it == end(context))
-            throw UndeclaredVariableError(_name);
-        return it->second;
+    auto Variable::GetSymbol() const -> SymbolId {
+        return _symbol;
+    }
+
+    auto Variable::GetSymbolTable() const -> const SymbolTable& {
+        return *_symbols;
+    }
+
+    bool Variable::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
+        auto value = context.Get(_symbol);
+        if (value < 0)
+            throw UndeclaredVariableError(GetName());
+        return value != 0;
+    }
+
+    auto Variable::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto value = context.Get(_symbol);
+        if (value < 0)
+            return Clone();
+        return make_unique<Const>(value != 0);
     }
 
     void Variable::Traverse(Visitor* visitor) const {
@@ -83,11 +134,11 @@ namespace logic {
     }
 
     auto Variable::Clone() const -> unique_ptr<Expression> {
-        return make_unique<Variable>(_name);
+        return make_unique<Variable>(_symbol, *_symbols);
     }
 
     void Variable::ToString(ostream& os) const {
-        os << _name;
+        os << GetName();
     }
 
     void ReprCachable::ToString(ostream& os) const {
@@ -99,8 +150,26 @@ namespace logic {
         os << _repr;
     }
 
+    void ReprCachable::ResetRepr() {
+        _repr.clear();
+    }
+
     UnaryOp::UnaryOp(unique_ptr<Expression>&& x): _x(move(x)) { }
 
+    size_t UnaryOp::GetOperandCount() const {
+        return 1;
+    }
+
+    auto UnaryOp::GetOperand(size_t) const -> const Expression* {
+        return _x.get();
+    }
+
+    auto UnaryOp::ReplaceOperand(size_t, unique_ptr<Expression>&& x) -> unique_ptr<Expression> {
+        ResetRepr();
+        swap(_x, x);
+        return move(x);
+    }
+
     void UnaryOp::Traverse(Visitor* visitor) const {
         _x->Traverse(visitor);
         visitor->Visit(this);
@@ -123,10 +192,15 @@ namespace logic {
             os << _GetSign();
     }
 
-    bool Not::Evaluate(const map<string, bool>& context) const {
+    bool Not::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return !_x->Evaluate(context);
     }
 
+    auto Not::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        return Negate(_x->Specialize(context));
+    }
+
     short Not::GetPriority() const {
         return 4;
     }
@@ -146,6 +220,20 @@ namespace logic {
     BinaryOp::BinaryOp(unique_ptr<Expression>&& a, unique_ptr<Expression>&& b):
         _a(move(a)), _b(move(b)) { }
 
+    size_t BinaryOp::GetOperandCount() const {
+        return 2;
+    }
+
+    auto BinaryOp::GetOperand(size_t i) const -> const Expression* {
+        return i ? _b.get() : _a.get();
+    }
+
+    auto BinaryOp::ReplaceOperand(size_t i, unique_ptr<Expression>&& x) -> unique_ptr<Expression> {
+        ResetRepr();
+        swap(i ? _b : _a, x);
+        return move(x);
+    }
+
     void BinaryOp::Traverse(Visitor* visitor) const {
         _a->Traverse(visitor);
         _b->Traverse(visitor);
@@ -169,10 +257,23 @@ namespace logic {
         return true;
     }
 
-    bool And::Evaluate(const map<string, bool>& context) const {
+    bool And::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return _a->Evaluate(context) && _b->Evaluate(context);
     }
 
+    auto And::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto a = _a->Specialize(context), b = _b->Specialize(context);
+        auto x = GetConstValue(*a), y = GetConstValue(*b);
+        if (!x || !y)
+            return make_unique<Const>(false);
+        if (x > 0)
+            return b;
+        if (y > 0)
+            return a;
+        return make_unique<And>(move(a), move(b));
+    }
+
     short And::GetPriority() const {
         return 3;
     }
@@ -185,10 +286,23 @@ namespace logic {
         return make_unique<And>(_a->Clone(), _b->Clone());
     }
 
-    bool Or::Evaluate(const map<string, bool>& context) const {
+    bool Or::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return _a->Evaluate(context) || _b->Evaluate(context);
     }
 
+    auto Or::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto a = _a->Specialize(context), b = _b->Specialize(context);
+        auto x = GetConstValue(*a), y = GetConstValue(*b);
+        if (x > 0 || y > 0)
+            return make_unique<Const>(true);
+        if (!x)
+            return b;
+        if (!y)
+            return a;
+        return make_unique<Or>(move(a), move(b));
+    }
+
     short Or::GetPriority() const {
         return 2;
     }
@@ -201,10 +315,21 @@ namespace logic {
         return make_unique<Or>(_a->Clone(), _b->Clone());
     }
 
-    bool Xor::Evaluate(const map<string, bool>& context) const {
+    bool Xor::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return _a->Evaluate(context) ^ _b->Evaluate(context);
     }
 
+    auto Xor::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto a = _a->Specialize(context), b = _b->Specialize(context);
+        auto x = GetConstValue(*a), y = GetConstValue(*b);
+        if (x >= 0)
+            return x ? Negate(move(b)) : move(b);
+        if (y >= 0)
+            return y ? Negate(move(a)) : move(a);
+        return make_unique<Xor>(move(a), move(b));
+    }
+
     short Xor::GetPriority() const {
         return 2;
     }
@@ -217,10 +342,23 @@ namespace logic {
         return make_unique<Xor>(_a->Clone(), _b->Clone());
     }
 
-    bool Implication::Evaluate(const map<string, bool>& context) const {
+    bool Implication::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return !_a->Evaluate(context) || _b->Evaluate(context);
     }
 
+    auto Implication::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto a = _a->Specialize(context), b = _b->Specialize(context);
+        auto x = GetConstValue(*a), y = GetConstValue(*b);
+        if (!x || y > 0)
+            return make_unique<Const>(true);
+        if (x > 0)
+            return b;
+        if (!y)
+            return Negate(move(a));
+        return make_unique<Implication>(move(a), move(b));
+    }
+
     short Implication::GetPriority() const {
         return 1;
     }
@@ -233,10 +371,21 @@ namespace logic {
         return make_unique<Implication>(_a->Clone(), _b->Clone());
     }
 
-    bool Equivalence::Evaluate(const map<string, bool>& context) const {
+    bool Equivalence::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
         return _a->Evaluate(context) == _b->Evaluate(context);
     }
 
+    auto Equivalence::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        auto a = _a->Specialize(context), b = _b->Specialize(context);
+        auto x = GetConstValue(*a), y = GetConstValue(*b);
+        if (x >= 0)
+            return x ? move(b) : Negate(move(b));
+        if (y >= 0)
+            return y ? move(a) : Negate(move(a));
+        return make_unique<Equivalence>(move(a), move(b));
+    }
+
     short Equivalence::GetPriority() const {
         return 1;
     }
@@ -248,4 +397,163 @@ namespace logic {
     auto Equivalence::Clone() const -> unique_ptr<Expression> {
         return make_unique<Equivalence>(_a->Clone(), _b->Clone());
     }
+
+    NaryOp::NaryOp(vector<unique_ptr<Expression>>&& operands): _operands(move(operands)) { }
+
+    NaryOp::NaryOp(unique_ptr<Expression>&& a, unique_ptr<Expression>&& b) {
+        _operands.reserve(2);
+        _operands.push_back(move(a));
+        _operands.push_back(move(b));
+    }
+
+    void NaryOp::Append(unique_ptr<Expression>&& x) {
+        _operands.push_back(move(x));
+    }
+
+    size_t NaryOp::GetOperandCount() const {
+        return _operands.size();
+    }
+
+    auto NaryOp::GetOperand(size_t i) const -> const Expression* {
+        return _operands[i].get();
+    }
+
+    auto NaryOp::ReplaceOperand(size_t i, unique_ptr<Expression>&& x) -> unique_ptr<Expression> {
+        ResetRepr();
+        swap(_operands[i], x);
+        return move(x);
+    }
+
+    void NaryOp::Traverse(Visitor* visitor) const {
+        for (const auto& x: _operands)
+            x->Traverse(visitor);
+        visitor->Visit(this);
+    }
+
+    bool NaryOp::IsLeftAssociative() const {
+        return true;
+    }
+
+    void NaryOp::_ToString(ostream& os) const {
+        auto prio = GetPriority();
+        for (size_t i = 0; i < _operands.size(); i++) {
+            const auto& x = _operands[i];
+            auto xPrio = x->GetPriority();
+            bool needsBraces = prio > xPrio || (i && prio == xPrio && x->IsLeftAssociative());
+            if (i)
+                os << _GetSign();
+            if (needsBraces) { os << '('; }
+            x->ToString(os);
+            if (needsBraces) { os << ')'; }
+        }
+    }
+
+    auto NaryOp::_CloneOperands() const -> vector<unique_ptr<Expression>> {
+        vector<unique_ptr<Expression>> result;
+        result.reserve(_operands.size());
+        for (const auto& x: _operands)
+            result.push_back(x->Clone());
+        return result;
+    }
+
+    bool NaryAnd::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
+        for (const auto& x: _operands)
+            if (!x->Evaluate(context))
+                return false;
+        return true;
+    }
+
+    auto NaryAnd::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        vector<unique_ptr<Expression>> operands;
+        for (const auto& x: _operands) {
+            auto y = x->Specialize(context);
+            auto value = GetConstValue(*y);
+            if (!value)
+                return make_unique<Const>(false);
+            if (value < 0)
+                operands.push_back(move(y));
+        }
+        return Join<NaryAnd>(move(operands), true);
+    }
+
+    short NaryAnd::GetPriority() const {
+        return 3;
+    }
+
+    const char* NaryAnd::_GetSign() const {
+        return " & ";
+    }
+
+    auto NaryAnd::Clone() const -> unique_ptr<Expression> {
+        return make_unique<NaryAnd>(_CloneOperands());
+    }
+
+    bool NaryOr::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
+        for (const auto& x: _operands)
+            if (x->Evaluate(context))
+                return true;
+        return false;
+    }
+
+    auto NaryOr::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        vector<unique_ptr<Expression>> operands;
+        for (const auto& x: _operands) {
+            auto y = x->Specialize(context);
+            auto value = GetConstValue(*y);
+            if (value > 0)
+                return make_unique<Const>(true);
+            if (value < 0)
+                operands.push_back(move(y));
+        }
+        return Join<NaryOr>(move(operands), false);
+    }
+
+    short NaryOr::GetPriority() const {
+        return 2;
+    }
+
+    const char* NaryOr::_GetSign() const {
+        return " | ";
+    }
+
+    auto NaryOr::Clone() const -> unique_ptr<Expression> {
+        return make_unique<NaryOr>(_CloneOperands());
+    }
+
+    bool NaryXor::Evaluate(const Context& context) const {
+        LOGIC_STATS_COUNT(stats::EVALUATIONS, 1);
+        bool result = false;
+        for (const auto& x: _operands)
+            result ^= x->Evaluate(context);
+        return result;
+    }
+
+    auto NaryXor::Specialize(const Context& context) const -> unique_ptr<Expression> {
+        vector<unique_ptr<Expression>> operands;
+        bool parity = false;
+        for (const auto& x: _operands) {
+            auto y = x->Specialize(context);
+            auto value = GetConstValue(*y);
+            if (value < 0)
+                operands.push_back(move(y));
+            else
+                parity ^= value != 0;
+        }
+        auto result = Join<NaryXor>(move(operands), false);
+        return parity ? Negate(move(result)) : move(result);
+    }
+
+    short NaryXor::GetPriority() const {
+        return 2;
+    }
+
+    const char* NaryXor::_GetSign() const {
+        return " ^ ";
+    }
+
+    auto NaryXor::Clone() const -> unique_ptr<Expression> {
+        return make_unique<NaryXor>(_CloneOperands());
+    }
 }
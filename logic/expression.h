@@ -20,16 +20,20 @@
 #pragma once
 
 #include <iostream>
-#include <map>
 #include <memory>
 #include <string>
+#include <vector>
+#include "symbol_table.h"
 #include "visitor.h"
 
 namespace logic {
     /*interface*/ class Expression {
     public:
         virtual ~Expression() = default;
-        virtual bool Evaluate(const std::map<std::string, bool>&) const = 0;
+        virtual bool Evaluate(const Context&) const = 0;
+        // Returns a copy with the variables set in the context replaced by their values and the
+        // constants folded away. Other variables are kept.
+        virtual auto Specialize(const Context&) const -> std::unique_ptr<Expression> = 0;
         virtual void Traverse(Visitor*) const = 0;
         virtual short GetPriority() const = 0;
         virtual bool IsLeftAssociative() const = 0;
@@ -41,7 +45,8 @@ namespace logic {
     public:
         /*implicit*/ Const(bool = false);
         bool GetValue() const;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         void Traverse(Visitor*) const;
         short GetPriority() const;
         bool IsLeftAssociative() const;
@@ -54,11 +59,14 @@ namespace logic {
 
     class Variable: public Expression {
     public:
-        Variable() = default;
+        // Interns the name into the default symbol table.
         explicit Variable(const std::string&);
-        explicit Variable(std::string&&);
-        std::string GetName() const;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        Variable(SymbolId, const SymbolTable&);
+        auto GetName() const -> const std::string&;
+        auto GetSymbol() const -> SymbolId;
+        auto GetSymbolTable() const -> const SymbolTable&;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         void Traverse(Visitor*) const;
         short GetPriority() const;
         bool IsLeftAssociative() const;
@@ -66,12 +74,15 @@ namespace logic {
         void ToString(std::ostream&) const;
 
     private:
-        std::string _name;
+        SymbolId _symbol;
+        const SymbolTable* _symbols;
     };
 
     /*abstract*/ class ReprCachable: public Expression {
     public:
         void ToString(std::ostream&) const;
+        // Drops the cached representation. Has to be called on every ancestor of a changed node.
+        void ResetRepr();
 
     protected:
         virtual void _ToString(std::ostream&) const = 0;
@@ -81,6 +92,13 @@ namespace logic {
     };
 
     /*abstract*/ class Operator: public ReprCachable {
+    public:
+        virtual size_t GetOperandCount() const = 0;
+        virtual auto GetOperand(size_t) const -> const Expression* = 0;
+        // Returns the previous operand.
+        virtual auto ReplaceOperand(size_t, std::unique_ptr<Expression>&&)
+            -> std::unique_ptr<Expression> = 0;
+
     protected:
         virtual const char* _GetSign() const = 0;
     };
@@ -88,6 +106,9 @@ namespace logic {
     /*abstract*/ class UnaryOp: public Operator {
     public:
         explicit UnaryOp(std::unique_ptr<Expression>&& = nullptr);
+        size_t GetOperandCount() const;
+        auto GetOperand(size_t) const -> const Expression*;
+        auto ReplaceOperand(size_t, std::unique_ptr<Expression>&&) -> std::unique_ptr<Expression>;
         void Traverse(Visitor*) const;
         bool IsLeftAssociative() const;
 
@@ -101,7 +122,8 @@ namespace logic {
     class Not: public UnaryOp {
     public:
         using UnaryOp::UnaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
@@ -114,6 +136,9 @@ namespace logic {
     public:
         BinaryOp() = default;
         BinaryOp(std::unique_ptr<Expression>&&, std::unique_ptr<Expression>&&);
+        size_t GetOperandCount() const;
+        auto GetOperand(size_t) const -> const Expression*;
+        auto ReplaceOperand(size_t, std::unique_ptr<Expression>&&) -> std::unique_ptr<Expression>;
         void Traverse(Visitor*) const;
 
     protected:
@@ -131,7 +156,8 @@ namespace logic {
     class And: public LeftAssociativeBinaryOp {
     public:
         using LeftAssociativeBinaryOp::LeftAssociativeBinaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
@@ -142,7 +168,8 @@ namespace logic {
     class Or: public LeftAssociativeBinaryOp {
     public:
         using LeftAssociativeBinaryOp::LeftAssociativeBinaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
@@ -153,7 +180,8 @@ namespace logic {
     class Xor: public LeftAssociativeBinaryOp {
     public:
         using LeftAssociativeBinaryOp::LeftAssociativeBinaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
@@ -164,7 +192,8 @@ namespace logic {
     class Implication: public LeftAssociativeBinaryOp {
     public:
         using LeftAssociativeBinaryOp::LeftAssociativeBinaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
@@ -175,7 +204,65 @@ namespace logic {
     class Equivalence: public LeftAssociativeBinaryOp {
     public:
         using LeftAssociativeBinaryOp::LeftAssociativeBinaryOp;
-        bool Evaluate(const std::map<std::string, bool>&) const;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
+        short GetPriority() const;
+        auto Clone() const -> std::unique_ptr<Expression>;
+
+    protected:
+        const char* _GetSign() const;
+    };
+
+    // A left-associative chain `x1 op x2 op ... op xn` stored as a flat array of operands.
+    // It is printed exactly as the equivalent left-deep tree of binary operators.
+    /*abstract*/ class NaryOp: public Operator {
+    public:
+        NaryOp() = default;
+        explicit NaryOp(std::vector<std::unique_ptr<Expression>>&&);
+        NaryOp(std::unique_ptr<Expression>&&, std::unique_ptr<Expression>&&);
+        void Append(std::unique_ptr<Expression>&&);
+        size_t GetOperandCount() const;
+        auto GetOperand(size_t) const -> const Expression*;
+        auto ReplaceOperand(size_t, std::unique_ptr<Expression>&&) -> std::unique_ptr<Expression>;
+        void Traverse(Visitor*) const;
+        bool IsLeftAssociative() const;
+
+    protected:
+        std::vector<std::unique_ptr<Expression>> _operands;
+
+        void _ToString(std::ostream&) const;
+        auto _CloneOperands() const -> std::vector<std::unique_ptr<Expression>>;
+    };
+
+    class NaryAnd: public NaryOp {
+    public:
+        using NaryOp::NaryOp;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
+        short GetPriority() const;
+        auto Clone() const -> std::unique_ptr<Expression>;
+
+    protected:
+        const char* _GetSign() const;
+    };
+
+    class NaryOr: public NaryOp {
+    public:
+        using NaryOp::NaryOp;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
+        short GetPriority() const;
+        auto Clone() const -> std::unique_ptr<Expression>;
+
+    protected:
+        const char* _GetSign() const;
+    };
+
+    class NaryXor: public NaryOp {
+    public:
+        using NaryOp::NaryOp;
+        bool Evaluate(const Context&) const;
+        auto Specialize(const Context&) const -> std::unique_ptr<Expression>;
         short GetPriority() const;
         auto Clone() const -> std::unique_ptr<Expression>;
 
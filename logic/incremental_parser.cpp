@@ -0,0 +1,511 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "incremental_parser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    const size_t NONE = size_t(-1);
+    // An own symbol table is rebuilt when it has this many more symbols than twice the text size.
+    const size_t SYMBOL_SLACK = 1024;
+
+    enum ScanResult {
+        SCAN_OK,
+        SCAN_UNBALANCED,
+        SCAN_INVALID,
+    };
+
+    const size_t BLOCK_SIZE = 256;
+
+    size_t CommonPrefix(const char* a, const char* b, size_t size) {
+        size_t i = 0;
+        while (i + BLOCK_SIZE <= size && !memcmp(a + i, b + i, BLOCK_SIZE))
+            i += BLOCK_SIZE;
+        while (i < size && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    // `a` and `b` point past the ends.
+    size_t CommonSuffix(const char* a, const char* b, size_t size) {
+        size_t i = 0;
+        while (i + BLOCK_SIZE <= size &&
+                !memcmp(a - i - BLOCK_SIZE, b - i - BLOCK_SIZE, BLOCK_SIZE))
+            i += BLOCK_SIZE;
+        while (i < size && a[-1 - ptrdiff_t(i)] == b[-1 - ptrdiff_t(i)])
+            i++;
+        return i;
+    }
+
+    bool IsBrace(TokenId id) {
+        return id == TK_OPEN_BRACE || id == TK_CLOSE_BRACE;
+    }
+}
+
+namespace logic {
+    IncrementalParser::IncrementalParser(bool flatten):
+        _flatten(flatten), _ownSymbols(new SymbolTable), _symbols(_ownSymbols.get()), _gap(0),
+        _gapSize(0) { }
+
+    IncrementalParser::IncrementalParser(bool flatten, SymbolTable& symbols):
+        _flatten(flatten), _symbols(&symbols), _gap(0), _gapSize(0) { }
+
+    auto IncrementalParser::Update(const string& text) -> const Expression& {
+        // The text before the gap and the one after it are compared separately.
+        auto size = _GetTextSize();
+        auto limit = min(text.size(), size);
+        auto head = min(limit, _gap);
+        auto prefix = CommonPrefix(_buffer.data(), text.data(), head);
+        if (prefix == head)
+            prefix += CommonPrefix(_buffer.data() + _gap + _gapSize, text.data() + head,
+                limit - head);
+        if (_root && prefix == text.size() && prefix == size)
+            return *_root;
+        auto tail = min(limit - prefix, size - _gap);
+        auto textEnd = text.data() + text.size();
+        auto suffix = CommonSuffix(_buffer.data() + _buffer.size(), textEnd, tail);
+        if (suffix == tail)
+            suffix += CommonSuffix(_buffer.data() + _gap, textEnd - suffix, limit - prefix - tail);
+        return _Apply(prefix, size - suffix, text.data() + prefix, text.size() - suffix - prefix);
+    }
+
+    auto IncrementalParser::Edit(size_t offset, size_t length, const string& replacement)
+        -> const Expression& {
+        auto size = _GetTextSize();
+        if (offset > size || length > size - offset)
+            throw out_of_range("IncrementalParser::Edit");
+        return _Apply(offset, offset + length, replacement.data(), replacement.size());
+    }
+
+    auto IncrementalParser::GetText() const -> string {
+        string result;
+        _CopyText(0, _GetTextSize(), result);
+        return result;
+    }
+
+    auto IncrementalParser::GetExpression() const -> const Expression* {
+        return _root.get();
+    }
+
+    auto IncrementalParser::GetSymbolTable() const -> const SymbolTable& {
+        return *_symbols;
+    }
+
+    // Characters [damageBegin, damageEnd) of the current text are replaced with `size`
+    // characters at `replacement`.
+    auto IncrementalParser::_Apply(
+        size_t damageBegin, size_t damageEnd, const char* replacement, size_t size
+    ) -> const Expression& {
+        // Each rebuild takes at least as many interned names as the text has characters.
+        if (_ownSymbols && _root && _symbols->GetSize() > 2 * _GetTextSize() + SYMBOL_SLACK) {
+            auto text = GetText();
+            _root.reset();
+            _parents.clear();
+            _head.clear();
+            _tail.clear();
+            _buffer.clear();
+            _gap = _gapSize = 0;
+            _ownSymbols.reset(new SymbolTable);
+            _symbols = _ownSymbols.get();
+            _Apply(0, 0, text.data(), text.size());
+        }
+
+        // Old offsets past the damage are moved by this much (modulo 2 ** N).
+        auto shift = size - (damageEnd - damageBegin);
+        auto newSize = _GetTextSize() + shift;
+        auto replacementEnd = damageBegin + size;
+        auto getChar = [&](size_t i) {
+            return i < damageBegin ? _GetChar(i) :
+                i < replacementEnd ? replacement[i - damageBegin] : _GetChar(i - shift);
+        };
+        // Appends characters [b, e) of the new text to `out`.
+        auto copyText = [&](size_t b, size_t e, string& out) {
+            if (b < damageBegin)
+                _CopyText(b, min(e, damageBegin), out);
+            if (b < replacementEnd && e > damageBegin)
+                out.append(replacement + (max(b, damageBegin) - damageBegin),
+                    replacement + (min(e, replacementEnd) - damageBegin));
+            if (e > replacementEnd)
+                _CopyText(max(b, replacementEnd) - shift, e - shift, out);
+        };
+
+        // Re-lex from the damage (or the token touching it, which may grow) until a token boundary
+        // that cannot move; old tokens [first, last) are replaced with `tokens`.
+        auto n = _GetCount();
+        auto lowerBound = [&](size_t offset) {
+            size_t lo = 0, hi = n;
+            while (lo < hi) {
+                auto mid = lo + (hi - lo) / 2;
+                if (_GetSpan(mid).begin < offset)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        };
+        size_t first = lowerBound(damageBegin);
+        if (first && _GetSpan(first - 1).end >= damageBegin &&
+                !IsBrace(_GetEntry(first - 1).token.id))
+            first--;
+        size_t last = lowerBound(damageEnd);
+        size_t lexBegin = first < n ? min(_GetSpan(first).begin, damageBegin) : damageBegin;
+        vector<Token> tokens;
+        vector<TokenSpan> spans;
+        string region;
+        for (; ; last++) {
+            // A brace or a token after a space starts the same way whatever precedes it.
+            bool boundary = true;
+            size_t lexEnd = newSize;
+            if (last < n) {
+                auto span = _GetSpan(last);
+                boundary = IsBrace(_GetEntry(last).token.id) || !(span.begin + shift) ||
+                    isspace(static_cast<unsigned char>(getChar(span.begin + shift - 1)));
+                lexEnd = (boundary ? span.begin : span.end) + shift;
+            }
+            region.clear();
+            copyText(lexBegin, lexEnd, region);
+            tokens = Lexer(region.data(), region.size(), *_symbols).Tokenize(&spans);
+            tokens.pop_back();
+            spans.pop_back();
+            for (auto& s: spans) {
+                s.begin += lexBegin;
+                s.end += lexBegin;
+            }
+            if (boundary) {
+                last = min(last, n);
+                break;
+            }
+            if (!tokens.empty() && tokens.back().id == _GetEntry(last).token.id &&
+                    spans.back().begin == _GetSpan(last).begin + shift &&
+                    spans.back().end == lexEnd) {
+                last++;
+                break;
+            }
+        }
+
+        // New token `j` in terms of the old stream and `tokens`.
+        auto m = tokens.size(), removed = last - first;
+        auto tokenAt = [&](size_t j) -> const Token& {
+            return j < first ? _GetEntry(j).token :
+                j < first + m ? tokens[j - first] : _GetEntry(j - m + removed).token;
+        };
+        auto toNew = [&](size_t i) { return i < first ? i : i + m - removed; };
+        auto toOld = [&](size_t j) { return j < first ? j : j - m + removed; };
+
+        // Check the interior of the innermost group enclosing the damage, widening it while its
+        // braces are unbalanced. Groups untouched by the damage are not looked into.
+        size_t open = _root ? _FindEnclosing(first, last) : NONE;
+        size_t lo, hi;
+        vector<pair<size_t, size_t>> pairs;
+        vector<size_t> reused;
+        for (; ; open = _FindEnclosing(open, last)) {
+            lo = open == NONE ? 0 : open + 1;
+            hi = open == NONE ? n - removed + m : toNew(_GetMatch(open));
+            pairs.clear();
+            reused.clear();
+            vector<size_t> stack;
+            bool operand = true;
+            auto result = SCAN_OK;
+            for (auto j = lo; j < hi && result == SCAN_OK; j++)
+                switch (tokenAt(j).id) {
+                case TK_OPEN_BRACE:
+                    if (!operand)
+                        result = SCAN_INVALID;
+                    else if (j < first ? _GetMatch(j) < first : j >= first + m) {
+                        reused.push_back(j);
+                        j = toNew(_GetMatch(toOld(j)));
+                        operand = false;
+                    } else
+                        stack.push_back(j);
+                    break;
+                case TK_CLOSE_BRACE:
+                    if (stack.empty())
+                        result = SCAN_UNBALANCED;
+                    else if (operand)
+                        result = SCAN_INVALID;
+                    else {
+                        pairs.emplace_back(stack.back(), j);
+                        stack.pop_back();
+                    }
+                    break;
+                case TK_NOT:
+                    if (!operand)
+                        result = SCAN_INVALID;
+                    break;
+                case TK_LITERAL:
+                case TK_VARIABLE:
+                    if (!operand)
+                        result = SCAN_INVALID;
+                    operand = false;
+                    break;
+                default:
+                    if (operand)
+                        result = SCAN_INVALID;
+                    operand = true;
+                }
+            if (result == SCAN_OK && !stack.empty())
+                result = SCAN_UNBALANCED;
+            if (result == SCAN_OK && operand)
+                result = SCAN_INVALID;
+            if (result == SCAN_OK)
+                break;
+            if (result == SCAN_INVALID || open == NONE)
+                throw SyntaxError("");
+        }
+
+        // The new text is valid: take the old subtree of the group apart.
+        const Expression* oldRoot = open == NONE ? _root.get() : _GetEntry(open).group;
+        Link link = { nullptr, 0 };
+        if (oldRoot && oldRoot != _root.get())
+            link = _parents.at(oldRoot);
+        auto oldTree = oldRoot ? _Detach(oldRoot) : nullptr;
+        deque<unique_ptr<Expression>> slots;
+        for (auto j: reused) {
+            auto group = _GetEntry(toOld(j)).group;
+            slots.push_back(group == oldRoot ? move(oldTree) : _Detach(group));
+        }
+        _Forget(oldTree.get());
+        oldTree.reset();
+
+        unique_ptr<Expression> newRoot;
+        try {
+            // Replace the tokens at the gap; the ones past it and the braces enclosing the damage
+            // stay as they are.
+            _MoveGap(first);
+            _tail.resize(_tail.size() - removed);
+            _ReplaceText(damageBegin, damageEnd, replacement, size);
+            for (size_t k = 0; k < m; k++)
+                _head.push_back({ tokens[k], spans[k], 0, nullptr });
+            for (const auto& p: pairs) {
+                _SetMatch(p.first, p.second);
+                _SetMatch(p.second, p.first);
+                _GetEntry(p.first).group = nullptr;
+            }
+
+            // Parse the groups inside out, handing the reused and the freshly built subtrees to
+            // the enclosing groups as `TK_EXPRESSION` tokens.
+            size_t next = 0;
+            vector<Group> groups(1);
+            groups[0].open = open;
+            for (auto j = lo; j < hi; j++) {
+                auto& e = _GetEntry(j);
+                if (e.token.id == TK_OPEN_BRACE && e.group) {
+                    groups.back().tokens.emplace_back(&slots[next++]);
+                    groups.back().children.push_back(e.group);
+                    j = _GetMatch(j);
+                } else if (e.token.id == TK_OPEN_BRACE) {
+                    groups.emplace_back();
+                    groups.back().open = j;
+                } else if (e.token.id == TK_CLOSE_BRACE) {
+                    auto result = _Parse(groups.back());
+                    _GetEntry(groups.back().open).group = result.get();
+                    groups.pop_back();
+                    slots.push_back(move(result));
+                    groups.back().tokens.emplace_back(&slots.back());
+                    groups.back().children.push_back(slots.back().get());
+                } else
+                    groups.back().tokens.push_back(e.token);
+            }
+            newRoot = _Parse(groups.back());
+        } catch (...) {
+            _buffer.clear();
+            _gap = _gapSize = 0;
+            _head.clear();
+            _tail.clear();
+            _root.reset();
+            _parents.clear();
+            throw;
+        }
+
+        auto newRootPtr = newRoot.get();
+        if (link.parent) {
+            link.parent->ReplaceOperand(link.index, move(newRoot));
+            _parents[newRootPtr] = link;
+            auto it = _parents.find(link.parent);
+            for (; it != end(_parents); it = _parents.find(it->second.parent))
+                it->second.parent->ResetRepr();
+        } else
+            _root = move(newRoot);
+        if (open != NONE) {
+            _GetEntry(open).group = newRootPtr;
+            for (auto k = open; k && _GetEntry(k - 1).token.id == TK_OPEN_BRACE &&
+                    _GetMatch(k - 1) == _GetMatch(k) + 1; k--)
+                _GetEntry(k - 1).group = newRootPtr;
+        }
+        return *_root;
+    }
+
+    auto IncrementalParser::_GetTextSize() const -> size_t {
+        return _buffer.size() - _gapSize;
+    }
+
+    auto IncrementalParser::_GetChar(size_t i) const -> char {
+        return _buffer[i < _gap ? i : i + _gapSize];
+    }
+
+    void IncrementalParser::_CopyText(size_t begin, size_t end, string& out) const {
+        if (begin >= end)
+            return;
+        if (begin < _gap)
+            out.append(_buffer, begin, min(end, _gap) - begin);
+        if (end > _gap) {
+            auto from = max(begin, _gap);
+            out.append(_buffer, from + _gapSize, end - from);
+        }
+    }
+
+    // Moves the gap to `begin`, so that only the characters between the two edits move.
+    void IncrementalParser::_ReplaceText(size_t begin, size_t end, const char* replacement,
+        size_t size) {
+        if (begin < _gap)
+            memmove(&_buffer[begin + _gapSize], &_buffer[begin], _gap - begin);
+        else if (begin > _gap)
+            memmove(&_buffer[_gap], &_buffer[_gap + _gapSize], begin - _gap);
+        _gap = begin;
+        _gapSize += end - begin;
+        if (_gapSize < size) {
+            auto grow = max(size - _gapSize, _buffer.size() / 2 + BLOCK_SIZE);
+            _buffer.insert(_gap, grow, '\0');
+            _gapSize += grow;
+        }
+        if (size)
+            memcpy(&_buffer[_gap], replacement, size);
+        _gap += size;
+        _gapSize -= size;
+    }
+
+    auto IncrementalParser::_GetCount() const -> size_t {
+        return _head.size() + _tail.size();
+    }
+
+    auto IncrementalParser::_GetEntry(size_t index) -> Entry& {
+        return index < _head.size() ? _head[index] : _tail[_GetCount() - 1 - index];
+    }
+
+    auto IncrementalParser::_GetEntry(size_t index) const -> const Entry& {
+        return index < _head.size() ? _head[index] : _tail[_GetCount() - 1 - index];
+    }
+
+    auto IncrementalParser::_GetSpan(size_t index) const -> TokenSpan {
+        if (index < _head.size())
+            return _head[index].span;
+        auto span = _tail[_GetCount() - 1 - index].span;
+        auto size = _GetTextSize();
+        return { size - span.begin, size - span.end };
+    }
+
+    auto IncrementalParser::_GetMatch(size_t index) const -> size_t {
+        auto match = _GetEntry(index).match;
+        return match >= 0 ? size_t(match) : size_t(match + ptrdiff_t(_GetCount()));
+    }
+
+    void IncrementalParser::_SetMatch(size_t index, size_t match) {
+        _GetEntry(index).match =
+            match < _head.size() ? ptrdiff_t(match) : ptrdiff_t(match - _GetCount());
+    }
+
+    // Tokens that cross the gap are converted and their matching braces are told where they are.
+    void IncrementalParser::_MoveGap(size_t index) {
+        auto size = _GetTextSize();
+        while (_head.size() > index) {
+            _tail.push_back(_head.back());
+            _head.pop_back();
+            auto& span = _tail.back().span;
+            span = { size - span.begin, size - span.end };
+            if (IsBrace(_tail.back().token.id))
+                _SetMatch(_GetMatch(_head.size()), _head.size());
+        }
+        while (_head.size() < index) {
+            _head.push_back(_tail.back());
+            _tail.pop_back();
+            auto& span = _head.back().span;
+            span = { size - span.begin, size - span.end };
+            if (IsBrace(_head.back().token.id))
+                _SetMatch(_GetMatch(_head.size() - 1), _head.size() - 1);
+        }
+    }
+
+    // The innermost group that opens before token `index` and closes at or after token `last`.
+    auto IncrementalParser::_FindEnclosing(size_t index, size_t last) const -> size_t {
+        if (index == NONE)
+            return NONE;
+        while (index--) {
+            const auto& e = _GetEntry(index);
+            if (e.token.id == TK_CLOSE_BRACE)
+                index = _GetMatch(index);
+            else if (e.token.id == TK_OPEN_BRACE && _GetMatch(index) >= last)
+                return index;
+        }
+        return NONE;
+    }
+
+    auto IncrementalParser::_Detach(const Expression* e) -> unique_ptr<Expression> {
+        if (e == _root.get())
+            return move(_root);
+        auto it = _parents.find(e);
+        auto link = it->second;
+        _parents.erase(it);
+        return link.parent->ReplaceOperand(link.index, nullptr);
+    }
+
+    void IncrementalParser::_Forget(const Expression* e) {
+        vector<const Expression*> stack;
+        if (e)
+            stack.push_back(e);
+        while (!stack.empty()) {
+            auto x = stack.back();
+            stack.pop_back();
+            _parents.erase(x);
+            if (auto op = dynamic_cast<const Operator*>(x))
+                for (size_t i = 0; i < op->GetOperandCount(); i++)
+                    if (auto y = op->GetOperand(i))
+                        stack.push_back(y);
+        }
+    }
+
+    // Parses the tokens of a group and records the parents of the new nodes.
+    auto IncrementalParser::_Parse(Group& group) -> unique_ptr<Expression> {
+        group.tokens.emplace_back();
+        auto result = Parser(group.tokens.data(), _flatten).Parse();
+        sort(begin(group.children), end(group.children));
+        vector<const Expression*> stack = { result.get() };
+        while (!stack.empty()) {
+            auto x = stack.back();
+            stack.pop_back();
+            if (binary_search(begin(group.children), end(group.children), x))
+                continue;
+            if (auto op = dynamic_cast<const Operator*>(x))
+                for (size_t i = 0; i < op->GetOperandCount(); i++) {
+                    auto y = op->GetOperand(i);
+                    // The tree is ours: the node is only reached through a const pointer.
+                    _parents[y] = { const_cast<Operator*>(op), i };
+                    stack.push_back(y);
+                }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "expression.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace logic {
+    // Parses successive versions of a formula. The tokens and the tree of the last accepted text
+    // are kept, so that after an edit only the tokens around the changed characters are re-lexed
+    // and only the innermost parenthesised group enclosing them is re-parsed. Subtrees of the
+    // groups left intact are moved into the new tree as they are.
+    class IncrementalParser {
+    public:
+        // Identifiers are interned into a table of the parser's own. Every text seen adds its
+        // identifiers, including the unfinished ones typed on the way, so the table is rebuilt
+        // from the current text when it grows much larger than that.
+        explicit IncrementalParser(bool flatten = false);
+        // Identifiers are interned into `symbols`, which then keeps growing with every edit.
+        IncrementalParser(bool flatten, SymbolTable& symbols);
+        // Makes `text` current and returns its expression, which stays valid until the next call.
+        // If the text is invalid, `LexicalError` or `SyntaxError` is thrown and the previous text
+        // stays current. Any other exception (e.g., `bad_alloc`) leaves the parser empty, as if
+        // just constructed.
+        auto Update(const std::string& text) -> const Expression&;
+        // Same as `Update` with `length` characters at `offset` of the current text replaced, but
+        // without comparing the texts to find the change.
+        auto Edit(size_t offset, size_t length, const std::string& replacement)
+            -> const Expression&;
+        auto GetText() const -> std::string;
+        // `nullptr` until some text is accepted.
+        auto GetExpression() const -> const Expression*;
+        // The table of the variables of the expression. It may change on every call.
+        auto GetSymbolTable() const -> const SymbolTable&;
+
+    private:
+        // Tokens are kept in a gap buffer at the last edit: `_head` holds the tokens before it
+        // and `_tail` the ones after it in reverse order. Spans of the tail tokens are counted
+        // from the end of the text, and braces whose match is in the tail refer to it by
+        // `index - count`, so that an edit does not touch anything past it.
+        struct Entry {
+            Token token;
+            TokenSpan span;
+            // For braces, the index of the matching one.
+            ptrdiff_t match;
+            // For an opening brace, the expression between the braces.
+            const Expression* group;
+        };
+
+        // Where a node hangs in the tree.
+        struct Link {
+            Operator* parent;
+            size_t index;
+        };
+
+        struct Group {
+            size_t open;
+            std::vector<Token> tokens;
+            std::vector<const Expression*> children;
+        };
+
+        bool _flatten;
+        std::unique_ptr<SymbolTable> _ownSymbols;
+        SymbolTable* _symbols;
+        // The text, with a gap of `_gapSize` characters at `_gap`.
+        std::string _buffer;
+        size_t _gap, _gapSize;
+        std::vector<Entry> _head, _tail;
+        std::unique_ptr<Expression> _root;
+        std::unordered_map<const Expression*, Link> _parents;
+
+        auto _Apply(size_t damageBegin, size_t damageEnd, const char* replacement, size_t size)
+            -> const Expression&;
+        auto _GetTextSize() const -> size_t;
+        auto _GetChar(size_t) const -> char;
+        void _CopyText(size_t begin, size_t end, std::string& out) const;
+        void _ReplaceText(size_t begin, size_t end, const char* replacement, size_t size);
+        auto _GetCount() const -> size_t;
+        auto _GetEntry(size_t) -> Entry&;
+        auto _GetEntry(size_t) const -> const Entry&;
+        auto _GetSpan(size_t) const -> TokenSpan;
+        auto _GetMatch(size_t) const -> size_t;
+        void _SetMatch(size_t index, size_t match);
+        void _MoveGap(size_t index);
+        auto _FindEnclosing(size_t index, size_t last) const -> size_t;
+        auto _Detach(const Expression*) -> std::unique_ptr<Expression>;
+        void _Forget(const Expression*);
+        auto _Parse(Group&) -> std::unique_ptr<Expression>;
+    };
+}
@@ -29,14 +29,25 @@ namespace logic {
         using std::logic_error::logic_error;
     };
 
+    // Offsets of the first character of a token and of the one past its end.
+    struct TokenSpan {
+        size_t begin, end;
+    };
+
     class Lexer {
     public:
         Lexer();
-        Lexer(const char*, size_t);
-        auto Tokenize() -> std::vector<Token>;
+        // Identifiers are interned into `symbols`, which must outlive the expressions parsed.
+        Lexer(const char*, size_t, SymbolTable& symbols = SymbolTable::GetDefault());
+        // Spans of the tokens (relative to the beginning of the input) are stored into `spans`
+        // if it is given.
+        auto Tokenize(std::vector<TokenSpan>* spans = nullptr) -> std::vector<Token>;
 
     private:
         std::vector<Token> _result;
+        std::vector<TokenSpan>* _spans;
+        SymbolTable* _symbols;
+        const char* _begin;
 
         int _cs;
         int _act;
@@ -44,5 +55,7 @@ namespace logic {
         const char* _pe;
         const char* _ts;
         const char* _te;
+
+        void _Emit(const Token&);
     };
 }
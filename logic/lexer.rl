@@ -19,6 +19,7 @@
 
 #include "lexer.h"
 #include <algorithm>
+#include "stats.h"
 
 using namespace std;
 
@@ -37,17 +38,17 @@ using namespace std;
     var = (alpha | '_') . (alnum | '_')*;
 
     main := |*
-        '(' => { _result.emplace_back(TK_OPEN_BRACE); };
-        ')' => { _result.emplace_back(TK_CLOSE_BRACE); };
-        '0' => { _result.emplace_back(TK_LITERAL, false); };
-        '1' => { _result.emplace_back(TK_LITERAL, true); };
-        var => { _result.emplace_back(TK_VARIABLE, _ts, _te - _ts); };
-        not => { _result.emplace_back(TK_NOT); };
-        and => { _result.emplace_back(TK_AND); };
-        or  => { _result.emplace_back(TK_OR); };
-        xor => { _result.emplace_back(TK_XOR); };
-        imp => { _result.emplace_back(TK_IMPLICATION); };
-        eq  => { _result.emplace_back(TK_EQUIVALENCE); };
+        '(' => { _Emit(Token(TK_OPEN_BRACE)); };
+        ')' => { _Emit(Token(TK_CLOSE_BRACE)); };
+        '0' => { _Emit(Token(TK_LITERAL, false)); };
+        '1' => { _Emit(Token(TK_LITERAL, true)); };
+        var => { _Emit(Token(TK_VARIABLE, _symbols, _symbols->Intern(_ts, _te - _ts))); };
+        not => { _Emit(Token(TK_NOT)); };
+        and => { _Emit(Token(TK_AND)); };
+        or  => { _Emit(Token(TK_OR)); };
+        xor => { _Emit(Token(TK_XOR)); };
+        imp => { _Emit(Token(TK_IMPLICATION)); };
+        eq  => { _Emit(Token(TK_EQUIVALENCE)); };
         space;
     *|;
 }%%
@@ -55,21 +56,35 @@ using namespace std;
 %% write data;
 
 namespace logic {
-    Lexer::Lexer(): _p(nullptr) { }
+    Lexer::Lexer(): _symbols(&SymbolTable::GetDefault()), _begin(nullptr), _p(nullptr) { }
 
-    Lexer::Lexer(const char* p, size_t size): _p(p), _pe(p + size) {
+    Lexer::Lexer(const char* p, size_t size, SymbolTable& symbols):
+        _symbols(&symbols), _begin(p), _p(p), _pe(p + size) {
         %% write init;
     }
 
-    vector<Token> Lexer::Tokenize() {
+    vector<Token> Lexer::Tokenize(vector<TokenSpan>* spans) {
         if (!_p)
             return { };
+        LOGIC_STATS_TIME(stats::LEXER);
         _result.clear();
+        _spans = spans;
+        if (_spans)
+            _spans->clear();
         auto eof = _pe;
         %% write exec;
         if (_cs != %%{ write first_final; }%%)
             throw LexicalError(_p);
+        LOGIC_STATS_COUNT(stats::TOKENS, _result.size());
         _result.emplace_back();
+        if (_spans)
+            _spans->push_back({ size_t(_pe - _begin), size_t(_pe - _begin) });
         return move(_result);
     }
+
+    void Lexer::_Emit(const Token& token) {
+        _result.push_back(token);
+        if (_spans)
+            _spans->push_back({ size_t(_ts - _begin), size_t(_te - _begin) });
+    }
 }
@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "minimizer.h"
+#include <algorithm>
+#include <functional>
+#include "dependency_visitor.h"
+#include "exception.h"
+#include "truth_table.h"
+#include "../make_unique.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+    using Cube = Minimizer::Cube;
+    using Bitset = vector<uint64_t>;
+
+    // Lanes whose `j`-th bit is zero.
+    const uint64_t LOW_MASKS[ ] = {
+        0x5555555555555555,
+        0x3333333333333333,
+        0x0F0F0F0F0F0F0F0F,
+        0x00FF00FF00FF00FF,
+        0x0000FFFF0000FFFF,
+        0x00000000FFFFFFFF,
+    };
+    const size_t COVER_BUDGET = 20000;
+
+    int PopCount(uint64_t x) {
+        int result = 0;
+        for (; x; x &= x - 1)
+            result++;
+        return result;
+    }
+
+    template <typename Callback>
+    void ForEachBit(uint64_t word, Callback callback) {
+        for (; word; word &= word - 1) {
+            uint32_t bit = 0;
+            while (!(word >> bit & 0x1))
+                bit++;
+            callback(bit);
+        }
+    }
+
+    template <typename Callback>
+    void ForEachBit(const Bitset& set, Callback callback) {
+        for (size_t w = 0; w < set.size(); w++)
+            ForEachBit(set[w], [&](uint32_t bit) { callback(uint32_t(w << 6 | bit)); });
+    }
+
+    bool IsEmpty(const Bitset& set) {
+        for (auto x: set)
+            if (x)
+                return false;
+        return true;
+    }
+
+    // `dst[r] = src[r] & src[r ^ (1 << j)]`.
+    void AndWithNeighbours(const Bitset& src, size_t j, Bitset& dst) {
+        dst.resize(src.size());
+        if (j < 6) {
+            size_t s = size_t(1) << j;
+            for (size_t w = 0; w < src.size(); w++) {
+                auto x = src[w];
+                dst[w] = x & ((x >> s & LOW_MASKS[j]) | (x & LOW_MASKS[j]) << s);
+            }
+        } else
+            for (size_t w = 0; w < src.size(); w++)
+                dst[w] = src[w] & src[w ^ (size_t(1) << (j - 6))];
+    }
+
+    // Calls `callback(word, lanes)` for every word that intersects the cube.
+    template <typename Callback>
+    void ForEachWord(size_t n, Cube c, Callback callback) {
+        uint64_t lanes = n >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << n)) - 1;
+        for (size_t j = 0; j < 6 && j < n; j++)
+            if (c.care >> j & 0x1)
+                lanes &= c.value >> j & 0x1 ? ~LOW_MASKS[j] : LOW_MASKS[j];
+        if (n <= 6) {
+            callback(size_t(0), lanes);
+            return;
+        }
+        size_t value = c.value >> 6, free = ~(c.care >> 6) & ((size_t(1) << (n - 6)) - 1);
+        size_t sub = 0;
+        do {
+            callback(value | sub, lanes);
+            sub = (sub - free) & free;
+        } while (sub);
+    }
+
+    bool IsImplicant(const Bitset& table, size_t n, Cube c) {
+        bool result = true;
+        ForEachWord(n, c, [&](size_t w, uint64_t lanes) {
+            result = result && (table[w] & lanes) == lanes;
+        });
+        return result;
+    }
+
+    Bitset GetCover(size_t n, Cube c, size_t words) {
+        Bitset result(words);
+        ForEachWord(n, c, [&](size_t w, uint64_t lanes) { result[w] |= lanes; });
+        return result;
+    }
+
+    int CountLiterals(Cube c) {
+        return PopCount(c.care);
+    }
+
+    // Bit-parallel Quine-McCluskey. `implicants` has bit `r` set iff the cube with don't-care
+    // positions `dontCare` that contains row `r` lies entirely in the ON-set.
+    void CollectPrimes(
+        size_t n, uint32_t dontCare, size_t minJ, const Bitset& implicants, vector<Cube>& primes
+    ) {
+        vector<Bitset> wider(n);
+        Bitset covered(implicants.size());
+        for (size_t j = 0; j < n; j++)
+            if (!(dontCare >> j & 0x1)) {
+                AndWithNeighbours(implicants, j, wider[j]);
+                for (size_t w = 0; w < covered.size(); w++)
+                    covered[w] |= wider[j][w];
+            }
+
+        uint32_t full = n == 32 ? ~uint32_t(0) : (uint32_t(1) << n) - 1;
+        Bitset prime(implicants.size());
+        // Only the representative with all don't-care bits zero is taken.
+        ForEachWord(n, { 0, dontCare }, [&](size_t w, uint64_t lanes) {
+            prime[w] = implicants[w] & ~covered[w] & lanes;
+        });
+        ForEachBit(prime, [&](uint32_t r) { primes.push_back({ r, ~dontCare & full }); });
+
+        for (size_t j = minJ; j < n; j++)
+            if (!(dontCare >> j & 0x1) && !IsEmpty(wider[j]))
+                CollectPrimes(n, dontCare | uint32_t(1) << j, j + 1, wider[j], primes);
+    }
+
+    vector<Cube> GetPrimes(const Bitset& table, size_t n) {
+        vector<Cube> primes;
+        if (!IsEmpty(table))
+            CollectPrimes(n, 0, 0, table, primes);
+        return primes;
+    }
+
+    struct CoverSearch {
+        vector<Bitset> covers;
+        vector<vector<uint32_t>> coveringPrimes;
+        vector<int> literals;
+        vector<size_t> best;
+        int bestLiterals;
+        size_t budget = COVER_BUDGET;
+
+        void Solve(const Bitset& uncovered, vector<size_t>& chosen, int chosenLiterals) {
+            if (!budget)
+                return;
+            budget--;
+            size_t minterm = SIZE_MAX, options = SIZE_MAX;
+            ForEachBit(uncovered, [&](uint32_t r) {
+                if (coveringPrimes[r].size() < options) {
+                    options = coveringPrimes[r].size();
+                    minterm = r;
+                }
+            });
+            if (minterm == SIZE_MAX) {
+                if (chosen.size() < best.size() ||
+                        (chosen.size() == best.size() && chosenLiterals < bestLiterals)) {
+                    best = chosen;
+                    bestLiterals = chosenLiterals;
+                }
+                return;
+            }
+            if (chosen.size() + 1 > best.size())
+                return;
+            for (auto p: coveringPrimes[minterm]) {
+                Bitset rest(uncovered);
+                for (size_t w = 0; w < rest.size(); w++)
+                    rest[w] &= ~covers[p][w];
+                chosen.push_back(p);
+                Solve(rest, chosen, chosenLiterals + literals[p]);
+                chosen.pop_back();
+            }
+        }
+    };
+
+    // Picks a cover of `table` among `primes`; returns whether it is proven minimal.
+    bool SelectCover(const Bitset& table, size_t n, vector<Cube>& primes) {
+        CoverSearch search;
+        search.coveringPrimes.resize(table.size() * 64);
+        for (size_t p = 0; p < primes.size(); p++) {
+            search.covers.push_back(GetCover(n, primes[p], table.size()));
+            search.literals.push_back(CountLiterals(primes[p]));
+            ForEachBit(search.covers.back(), [&](uint32_t r) {
+                search.coveringPrimes[r].push_back(p);
+            });
+        }
+
+        // A greedy cover is the starting bound.
+        Bitset uncovered(table);
+        search.bestLiterals = 0;
+        while (!IsEmpty(uncovered)) {
+            size_t bestPrime = 0;
+            int bestGain = -1;
+            for (size_t p = 0; p < primes.size(); p++) {
+                int gain = 0;
+                for (size_t w = 0; w < uncovered.size(); w++)
+                    gain += PopCount(uncovered[w] & search.covers[p][w]);
+                bool fewerLiterals = search.literals[p] < search.literals[bestPrime];
+                if (gain > bestGain || (gain == bestGain && fewerLiterals)) {
+                    bestGain = gain;
+                    bestPrime = p;
+                }
+            }
+            for (size_t w = 0; w < uncovered.size(); w++)
+                uncovered[w] &= ~search.covers[bestPrime][w];
+            search.best.push_back(bestPrime);
+            search.bestLiterals += search.literals[bestPrime];
+        }
+
+        vector<size_t> chosen;
+        search.Solve(table, chosen, 0);
+        vector<Cube> result;
+        for (auto p: search.best)
+            result.push_back(primes[p]);
+        primes = move(result);
+        return search.budget != 0;
+    }
+
+    // Espresso-style heuristic: every uncovered minterm is expanded into a prime implicant by
+    // dropping literals greedily, then redundant cubes are removed.
+    vector<Cube> CoverHeuristically(const Bitset& table, size_t n) {
+        uint32_t full = (uint32_t(1) << n) - 1;
+        vector<Cube> cubes;
+        Bitset uncovered(table);
+        ForEachBit(table, [&](uint32_t r) {
+            if (!(uncovered[r >> 6] >> (r & 0x3F) & 0x1))
+                return;
+            Cube c = { r, full };
+            for (size_t j = n; j--; ) {
+                Cube wider = { c.value & ~(uint32_t(1) << j), c.care & ~(uint32_t(1) << j) };
+                if (IsImplicant(table, n, wider))
+                    c = wider;
+            }
+            ForEachWord(n, c, [&](size_t w, uint64_t lanes) { uncovered[w] &= ~lanes; });
+            cubes.push_back(c);
+        });
+
+        // Irredundant: drop the smallest cubes first if the others cover them anyway.
+        sort(begin(cubes), end(cubes), [ ](Cube a, Cube b) {
+            return CountLiterals(a) > CountLiterals(b);
+        });
+        vector<uint32_t> counts(table.size() * 64);
+        auto forEachRow = [&](Cube c, function<void (uint32_t)> callback) {
+            ForEachWord(n, c, [&](size_t w, uint64_t lanes) {
+                ForEachBit(lanes, [&](uint32_t lane) { callback(uint32_t(w << 6 | lane)); });
+            });
+        };
+        for (auto c: cubes)
+            forEachRow(c, [&](uint32_t r) { counts[r]++; });
+        vector<Cube> result;
+        for (auto c: cubes) {
+            bool redundant = true;
+            forEachRow(c, [&](uint32_t r) { redundant = redundant && counts[r] > 1; });
+            if (redundant)
+                forEachRow(c, [&](uint32_t r) { counts[r]--; });
+            else
+                result.push_back(c);
+        }
+        return result;
+    }
+
+    unique_ptr<Expression> CreateLiteral(const SymbolTable& symbols, const string& name,
+        bool positive) {
+        unique_ptr<Expression> result = make_unique<Variable>(symbols.Find(name), symbols);
+        if (!positive)
+            result = make_unique<Not>(move(result));
+        return result;
+    }
+
+    // Builds `OR` of `AND`s (`conjunctive == false`) or `AND` of `OR`s of the cube literals;
+    // in the latter case the literals are negated.
+    unique_ptr<Expression> Build(
+        const SymbolTable* symbols, const vector<string>& variables, const vector<Cube>& cubes,
+        bool conjunctive
+    ) {
+        size_t n = variables.size();
+        unique_ptr<Expression> result;
+        for (auto c: cubes) {
+            unique_ptr<Expression> term;
+            for (size_t i = 0; i < n; i++) {
+                auto bit = n - i - 1;
+                if (!(c.care >> bit & 0x1))
+                    continue;
+                bool positive = bool(c.value >> bit & 0x1) != conjunctive;
+                auto literal = CreateLiteral(*symbols, variables[i], positive);
+                if (!term)
+                    term = move(literal);
+                else if (conjunctive)
+                    term = make_unique<Or>(move(term), move(literal));
+                else
+                    term = make_unique<And>(move(term), move(literal));
+            }
+            if (!term)
+                term = make_unique<Const>(!conjunctive);
+            if (!result)
+                result = move(term);
+            else if (conjunctive)
+                result = make_unique<And>(move(result), move(term));
+            else
+                result = make_unique<Or>(move(result), move(term));
+        }
+        if (!result)
+            result = make_unique<Const>(conjunctive);
+        return result;
+    }
+
+    vector<uint64_t> GetTable(const Expression& e, const vector<string>& variables) {
+        if (variables.size() > Minimizer::MAX_VARIABLES)
+            throw TooManyVariablesError(variables.size());
+        TruthTable table(variables, { &e });
+        vector<uint64_t> result((table.GetRowCount() + 63) / 64);
+        for (size_t b = 0; b < result.size(); b++)
+            table.GetBlock(b, &result[b]);
+        return result;
+    }
+}
+
+namespace logic {
+    Minimizer::Minimizer(const Expression& e) {
+        DependencyVisitor visitor;
+        e.Traverse(&visitor);
+        _variables = visitor.GetNames();
+        _symbols = visitor.GetSymbolTable();
+        // The formulas built refer to every variable through the table of the first one.
+        for (const auto& name: _variables)
+            if (_symbols->Find(name) == SymbolTable::NONE)
+                throw ForeignVariableError(name);
+        _table = GetTable(e, _variables);
+        _Minimize();
+    }
+
+    Minimizer::Minimizer(const vector<string>& variables, const vector<uint64_t>& table,
+        SymbolTable& symbols):
+        _variables(variables), _symbols(&symbols), _table(table) {
+        for (const auto& name: _variables)
+            symbols.Intern(name);
+        _Minimize();
+    }
+
+    auto Minimizer::GetPrimeImplicants() const -> vector<Cube> {
+        return GetPrimes(_table, _variables.size());
+    }
+
+    auto Minimizer::GetDnf() const -> unique_ptr<Expression> {
+        return Build(_symbols, _variables, _dnf, false);
+    }
+
+    auto Minimizer::GetCnf() const -> unique_ptr<Expression> {
+        return Build(_symbols, _variables, _cnf, true);
+    }
+
+    bool Minimizer::IsExact() const {
+        return _exact;
+    }
+
+    void Minimizer::_Minimize() {
+        auto n = _variables.size();
+        if (n > MAX_VARIABLES)
+            throw TooManyVariablesError(n);
+        _table.resize(((size_t(1) << n) + 63) / 64);
+        if (n < 6)
+            _table[0] &= (uint64_t(1) << (1 << n)) - 1;
+        Bitset complement(_table);
+        for (auto& x: complement)
+            x = ~x;
+        if (n < 6)
+            complement[0] &= (uint64_t(1) << (1 << n)) - 1;
+
+        if (n <= EXACT_MAX_VARIABLES) {
+            _dnf = GetPrimes(_table, n);
+            _cnf = GetPrimes(complement, n);
+            bool exactDnf = SelectCover(_table, n, _dnf);
+            bool exactCnf = SelectCover(complement, n, _cnf);
+            _exact = exactDnf && exactCnf;
+        } else {
+            _dnf = CoverHeuristically(_table, n);
+            _cnf = CoverHeuristically(complement, n);
+            _exact = false;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "expression.h"
+
+namespace logic {
+    // Two-level minimisation of a function given by its truth table. Tables are packed the same way
+    // as in `TruthTable`: bit `r % 64` of word `r / 64` is the value in row `r`, and row `r`
+    // assigns the `i`-th of `n` variables the value of bit `n - i - 1` of `r`.
+    class Minimizer {
+    public:
+        // Row `r` belongs to the cube iff `(r & care) == value`.
+        struct Cube {
+            uint32_t value, care;
+        };
+
+        // Up to this many variables, covers are searched exhaustively (within a time budget).
+        static const size_t EXACT_MAX_VARIABLES = 14;
+        static const size_t MAX_VARIABLES = 20;
+
+        // Throws `ForeignVariableError` if a variable is missing from the symbol table of the first
+        // one met.
+        explicit Minimizer(const Expression&);
+        // The variables are interned into `symbols`, which must outlive the formulas built.
+        Minimizer(const std::vector<std::string>& variables, const std::vector<uint64_t>& table,
+            SymbolTable& symbols = SymbolTable::GetDefault());
+
+        // Prime implicants of the function (exact method only).
+        auto GetPrimeImplicants() const -> std::vector<Cube>;
+        auto GetDnf() const -> std::unique_ptr<Expression>;
+        auto GetCnf() const -> std::unique_ptr<Expression>;
+        // Whether both covers are proven to have the least number of terms (and then literals).
+        bool IsExact() const;
+
+    private:
+        std::vector<std::string> _variables;
+        // Where the variables of the built formulas are found.
+        const SymbolTable* _symbols;
+        std::vector<uint64_t> _table;
+        std::vector<Cube> _dnf, _cnf;
+        bool _exact;
+
+        void _Minimize();
+    };
+}
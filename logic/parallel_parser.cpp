@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "parallel_parser.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "stats.h"
+#include "../make_unique.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    const size_t MIN_PARALLEL_SIZE = 1 << 16;
+    const size_t CHUNKS_PER_THREAD = 4;
+
+    struct Chunk {
+        size_t first, last;
+        // The change of the brace depth over the chunk and the lowest depth reached, relative to
+        // the start of the chunk.
+        long change, low;
+        // The depth at the start of the chunk.
+        long start;
+        // Operators at the lowest depth, by level: `->` and `<->`, `|` and `^`, `&`. They are
+        // outside braces if the lowest depth turns out to be the top level.
+        vector<size_t> operators[3];
+    };
+
+    // Runs `f(0)`, ..., `f(count - 1)` on up to `threadCount` threads and rethrows the first
+    // exception thrown.
+    template <typename F>
+    void ParallelFor(size_t count, size_t threadCount, F f) {
+        atomic<size_t> next(0);
+        atomic<bool> failed(false);
+        exception_ptr error;
+        mutex errorMutex;
+        auto worker = [&]( ) {
+            try {
+                for (size_t i; !failed && (i = next.fetch_add(1)) < count; )
+                    f(i);
+            }
+            catch (...) {
+                lock_guard<mutex> lock(errorMutex);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        };
+        vector<thread> threads;
+        for (size_t i = 1; i < min(threadCount, count); i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& t: threads)
+            t.join();
+        if (error)
+            rethrow_exception(error);
+    }
+
+    int GetLevel(TokenId id) {
+        switch (id) {
+        case TK_IMPLICATION:
+        case TK_EQUIVALENCE:
+            return 1;
+        case TK_OR:
+        case TK_XOR:
+            return 2;
+        case TK_AND:
+            return 3;
+        default:
+            return 0;
+        }
+    }
+
+    // The nodes are built exactly as the parser builds them.
+    template <class T, stats::Counter counter>
+    unique_ptr<Expression> CreateBinary(unique_ptr<Expression>&& a, unique_ptr<Expression>&& b) {
+        LOGIC_STATS_COUNT(counter, 1);
+        return make_unique<T>(move(a), move(b));
+    }
+
+    template <class T, class N, stats::Counter counter>
+    unique_ptr<Expression> Append(
+        bool flatten, unique_ptr<Expression>&& a, unique_ptr<Expression>&& b, bool chained
+    ) {
+        if (!flatten)
+            return CreateBinary<T, counter>(move(a), move(b));
+        if (chained)
+            if (auto nary = dynamic_cast<N*>(a.get())) {
+                nary->Append(move(b));
+                return move(a);
+            }
+        return CreateBinary<N, counter>(move(a), move(b));
+    }
+
+    auto Join(TokenId op, bool flatten, unique_ptr<Expression>&& a, unique_ptr<Expression>&& b,
+        bool chained) -> unique_ptr<Expression> {
+        switch (op) {
+        case TK_AND:
+            return Append<And, NaryAnd, stats::AND_NODES>(flatten, move(a), move(b), chained);
+        case TK_OR:
+            return Append<Or, NaryOr, stats::OR_NODES>(flatten, move(a), move(b), chained);
+        case TK_XOR:
+            return Append<Xor, NaryXor, stats::XOR_NODES>(flatten, move(a), move(b), chained);
+        case TK_IMPLICATION:
+            return CreateBinary<Implication, stats::IMPLICATION_NODES>(move(a), move(b));
+        default:
+            return CreateBinary<Equivalence, stats::EQUIVALENCE_NODES>(move(a), move(b));
+        }
+    }
+}
+
+namespace logic {
+    ParallelParser::ParallelParser(): _tokens(nullptr), _flatten(false), _threadCount(1) { }
+
+    ParallelParser::ParallelParser(const vector<Token>& tokens, bool flatten, size_t threadCount):
+        _tokens(&tokens), _flatten(flatten),
+        _threadCount(threadCount ? threadCount : max(thread::hardware_concurrency(), 1u)) { }
+
+    auto ParallelParser::Parse(const char hint[ ]) -> unique_ptr<Expression> {
+        if (!_tokens)
+            return nullptr;
+        return _Parse(0, _tokens->size() - 1, hint);
+    }
+
+    auto ParallelParser::_Parse(size_t first, size_t last, const char hint[ ]) const
+        -> unique_ptr<Expression> {
+        auto tokens = _tokens->data();
+        auto outer = first;
+        vector<size_t> splits;
+        unique_ptr<Expression> result;
+        if (!_FindSplits(first, last, splits))
+            result = _ParseSequentially(first, last, hint);
+        else {
+            // The operands are parsed side by side, a run at a time, and none is split further:
+            // it would be scanned again, as many times as there are nested braces.
+            vector<unique_ptr<Expression>> operands(splits.size() + 1);
+            auto getFirst = [&](size_t k) { return k ? splits[k - 1] + 1 : first; };
+            auto getLast = [&](size_t k) { return k < splits.size() ? splits[k] : last; };
+            auto runCount = min(operands.size(), _threadCount * CHUNKS_PER_THREAD);
+            ParallelFor(runCount, _threadCount, [&](size_t r) {
+                vector<Token> buffer;
+                auto k = operands.size() * r / runCount;
+                for (auto end = operands.size() * (r + 1) / runCount; k < end; k++)
+                    operands[k] = _ParseSequentially(getFirst(k), getLast(k), hint, buffer);
+            });
+            result = move(operands[0]);
+            for (size_t k = 0; k < splits.size(); k++)
+                result = Join(
+                    tokens[splits[k]].id, _flatten, move(result), move(operands[k + 1]), k != 0
+                );
+        }
+        // `!...!(...!...!(x)...)` is parsed as `x` with the negations applied.
+        for (auto i = outer; i < first; i++)
+            if (tokens[i].id == TK_NOT) {
+                LOGIC_STATS_COUNT(stats::NOT_NODES, 1);
+                result = make_unique<Not>(move(result));
+            }
+        return result;
+    }
+
+    bool ParallelParser::_FindSplits(size_t& first, size_t& last, vector<size_t>& splits) const {
+        auto tokens = _tokens->data();
+        // The braces around the range are taken off at most once: the inside is not wrapped again.
+        for (bool unwrapped = false; ; unwrapped = true) {
+            if (_threadCount < 2 || last - first < MIN_PARALLEL_SIZE)
+                return false;
+
+            // The prefix scan: brace depth changes per chunk, then the depths at the chunk starts.
+            vector<Chunk> chunks(_threadCount * CHUNKS_PER_THREAD);
+            for (size_t c = 0; c < chunks.size(); c++) {
+                chunks[c].first = first + (last - first) * c / chunks.size();
+                chunks[c].last = first + (last - first) * (c + 1) / chunks.size();
+            }
+            // Only the depths at the chunk starts depend on the other chunks, and the top level
+            // of a chunk can only be its lowest depth, so one pass over the tokens is enough.
+            ParallelFor(chunks.size(), _threadCount, [&](size_t c) {
+                auto& chunk = chunks[c];
+                long depth = 0, low = 0;
+                for (auto i = chunk.first; i < chunk.last; i++)
+                    if (tokens[i].id == TK_OPEN_BRACE)
+                        depth++;
+                    else if (tokens[i].id == TK_CLOSE_BRACE) {
+                        if (--depth < low) {
+                            low = depth;
+                            for (auto& operators: chunk.operators)
+                                operators.clear();
+                        }
+                    } else if (depth == low)
+                        if (auto level = GetLevel(tokens[i].id))
+                            chunk.operators[level - 1].push_back(i);
+                chunk.change = depth;
+                chunk.low = low;
+            });
+            long start = 0;
+            for (auto& chunk: chunks) {
+                // Unbalanced braces are left for the parser to report.
+                if (start + chunk.low < 0)
+                    return false;
+                if (start + chunk.low)
+                    for (auto& operators: chunk.operators)
+                        operators.clear();
+                chunk.start = start;
+                start += chunk.change;
+            }
+            if (start)
+                return false;
+
+            // Operators of the lowest priority are applied last, so they split the range.
+            for (size_t level = 0; level < 3 && splits.empty(); level++)
+                for (const auto& chunk: chunks) {
+                    const auto& operators = chunk.operators[level];
+                    splits.insert(splits.end(), operators.begin(), operators.end());
+                }
+            if (!splits.empty())
+                return true;
+            if (unwrapped)
+                return false;
+
+            // All the levels of `!...!(...!...!(` ... `)...)` are taken off at once: the first
+            // `levels` opening braces match the last `levels` closing ones if the depth between
+            // them does not fall below `levels`.
+            vector<size_t> opens;
+            for (auto i = first; i < last; i++)
+                if (tokens[i].id == TK_OPEN_BRACE)
+                    opens.push_back(i);
+                else if (tokens[i].id != TK_NOT)
+                    break;
+            size_t levels = 0;
+            while (levels < opens.size() && tokens[last - levels - 1].id == TK_CLOSE_BRACE)
+                levels++;
+            if (!levels)
+                return false;
+            // Whole chunks between the braces have their lowest depths, the rest is counted.
+            auto from = opens[levels - 1] + 1, to = last - levels;
+            auto low = long(levels);
+            for (const auto& chunk: chunks) {
+                if (chunk.last <= from || chunk.first >= to)
+                    continue;
+                if (chunk.first >= from && chunk.last <= to) {
+                    low = min(low, chunk.start + chunk.low);
+                    continue;
+                }
+                auto depth = chunk.start;
+                for (auto i = chunk.first; i < min(chunk.last, to); i++) {
+                    if (tokens[i].id == TK_OPEN_BRACE)
+                        depth++;
+                    else if (tokens[i].id == TK_CLOSE_BRACE)
+                        depth--;
+                    if (i >= from)
+                        low = min(low, depth);
+                }
+            }
+            if (!low)
+                return false;
+            first = opens[low - 1] + 1;
+            last -= low;
+        }
+    }
+
+    auto ParallelParser::_ParseSequentially(size_t first, size_t last, const char hint[ ]) const
+        -> unique_ptr<Expression> {
+        vector<Token> buffer;
+        return _ParseSequentially(first, last, hint, buffer);
+    }
+
+    auto ParallelParser::_ParseSequentially(
+        size_t first, size_t last, const char hint[ ], vector<Token>& buffer
+    ) const -> unique_ptr<Expression> {
+        if (last == _tokens->size() - 1)
+            return Parser(_tokens->data() + first, _flatten).Parse(hint);
+        // The parser needs `TK_EOF` after the range.
+        buffer.assign(_tokens->begin() + first, _tokens->begin() + last);
+        buffer.emplace_back();
+        return Parser(buffer.data(), _flatten).Parse(hint);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "expression.h"
+#include "parser.h"
+#include "token.h"
+
+namespace logic {
+    // Parses one large token array on several threads. Brace depths are found with a parallel
+    // prefix scan, the array is cut at the top-level operators of the lowest priority it has, and
+    // the pieces are parsed concurrently and joined left to right as `Parser` joins them. The tree
+    // (or the error) is the same as the one `Parser` gives.
+    class ParallelParser {
+    public:
+        ParallelParser();
+        // `tokens` must end with `TK_EOF`, as returned by `Lexer::Tokenize`.
+        explicit ParallelParser(
+            const std::vector<Token>& tokens, bool flatten = false, size_t threadCount = 0
+        );
+        auto Parse(const char hint[ ] = "") -> std::unique_ptr<Expression>;
+
+    private:
+        const std::vector<Token>* _tokens;
+        bool _flatten;
+        size_t _threadCount;
+
+        auto _Parse(size_t first, size_t last, const char hint[ ]) const
+            -> std::unique_ptr<Expression>;
+        // Takes the braces wrapping the range off it and finds the top-level operators it splits
+        // at. False if it is to be parsed sequentially (with the negations before `first` applied).
+        bool _FindSplits(size_t& first, size_t& last, std::vector<size_t>& splits) const;
+        auto _ParseSequentially(size_t first, size_t last, const char hint[ ]) const
+            -> std::unique_ptr<Expression>;
+        // `buffer` is reused between calls.
+        auto _ParseSequentially(
+            size_t first, size_t last, const char hint[ ], std::vector<Token>& buffer
+        ) const -> std::unique_ptr<Expression>;
+    };
+}
@@ -32,7 +32,9 @@ namespace logic {
     class Parser {
     public:
         Parser();
-        explicit Parser(const Token[ ]);
+        // If `flatten` is set, chains of `&`, `|` and `^` are built as `NaryOp`s instead of
+        // left-deep trees of `BinaryOp`s.
+        explicit Parser(const Token[ ], bool flatten = false);
         auto Parse(const char hint[ ] = "") -> std::unique_ptr<Expression>;
 
     private:
@@ -41,5 +43,6 @@ namespace logic {
         const Token* _p;
         const Token* _ts;
         const Token* _te;
+        bool _flatten;
     };
 }
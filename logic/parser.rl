@@ -19,6 +19,7 @@
 
 #include "parser.h"
 #include <vector>
+#include "stats.h"
 #include "../make_unique.h"
 
 using namespace std;
@@ -29,11 +30,29 @@ namespace {
     struct StackFrame {
         unique_ptr<Expression> lhs4, lhs3, lhs2, lhs1;
         int notCounter = 0;
-        auto (*binary)(unique_ptr<Expression>&&, unique_ptr<Expression>&&) -> unique_ptr<BinaryOp>;
+        // Whether `lhs3`/`lhs2` was built by this frame's chain (and not taken from braces).
+        bool chained3 = false, chained2 = false;
+        auto (*binary)(unique_ptr<Expression>&&, unique_ptr<Expression>&&, bool chained)
+            -> unique_ptr<Expression>;
     };
 
-    template <class T>
-    unique_ptr<BinaryOp> CreateBinary(unique_ptr<Expression>&& a, unique_ptr<Expression>&& b) {
+    template <class T, stats::Counter counter>
+    unique_ptr<Expression> CreateBinary(unique_ptr<Expression>&& a, unique_ptr<Expression>&& b,
+        bool) {
+        LOGIC_STATS_COUNT(counter, 1);
+        return make_unique<T>(move(a), move(b));
+    }
+
+    template <class T, stats::Counter counter>
+    unique_ptr<Expression> AppendNary(
+        unique_ptr<Expression>&& a, unique_ptr<Expression>&& b, bool chained
+    ) {
+        if (chained)
+            if (auto nary = dynamic_cast<T*>(a.get())) {
+                nary->Append(move(b));
+                return move(a);
+            }
+        LOGIC_STATS_COUNT(counter, 1);
         return make_unique<T>(move(a), move(b));
     }
 }
@@ -74,11 +93,17 @@ namespace {
     }
 
     action createLiteral {
+        LOGIC_STATS_COUNT(stats::CONST_NODES, 1);
         f->lhs4 = make_unique<Const>(fpc->value);
     }
 
     action createVariable {
-        f->lhs4 = make_unique<Variable>(string(fpc->identifier, fpc->size));
+        LOGIC_STATS_COUNT(stats::VARIABLE_NODES, 1);
+        f->lhs4 = make_unique<Variable>(fpc->symbol, *fpc->symbols);
+    }
+
+    action reuseExpression {
+        f->lhs4 = move(*fpc->subexpression);
     }
 
     action incNotCounter {
@@ -87,19 +112,33 @@ namespace {
 
     action setLhs4 {
         while (f->notCounter) {
+            LOGIC_STATS_COUNT(stats::NOT_NODES, 1);
             f->lhs4 = make_unique<Not>(move(f->lhs4));
             f->notCounter--;
         }
     }
 
-    action setAnd { f->binary = CreateBinary<And>; }
-    action setOr  { f->binary = CreateBinary<Or>; }
-    action setXor { f->binary = CreateBinary<Xor>; }
-    action setImp { f->binary = CreateBinary<Implication>; }
-    action setEq  { f->binary = CreateBinary<Equivalence>; }
+    action setAnd {
+        f->binary = _flatten ?
+            AppendNary<NaryAnd, stats::AND_NODES> : CreateBinary<And, stats::AND_NODES>;
+    }
+
+    action setOr {
+        f->binary = _flatten ?
+            AppendNary<NaryOr, stats::OR_NODES> : CreateBinary<Or, stats::OR_NODES>;
+    }
+
+    action setXor {
+        f->binary = _flatten ?
+            AppendNary<NaryXor, stats::XOR_NODES> : CreateBinary<Xor, stats::XOR_NODES>;
+    }
+
+    action setImp { f->binary = CreateBinary<Implication, stats::IMPLICATION_NODES>; }
+    action setEq  { f->binary = CreateBinary<Equivalence, stats::EQUIVALENCE_NODES>; }
 
     action first3 {
         f->lhs3 = move(f->lhs4);
+        f->chained3 = false;
     }
 
     # action append3 {
@@ -107,15 +146,24 @@ namespace {
     # }
 
     action appendAnd {
-        f->lhs3 = make_unique<And>(move(f->lhs3), move(f->lhs4));
+        if (_flatten)
+            f->lhs3 = AppendNary<NaryAnd, stats::AND_NODES>(move(f->lhs3), move(f->lhs4),
+                f->chained3);
+        else {
+            LOGIC_STATS_COUNT(stats::AND_NODES, 1);
+            f->lhs3 = make_unique<And>(move(f->lhs3), move(f->lhs4));
+        }
+        f->chained3 = true;
     }
 
     action first2 {
         f->lhs2 = move(f->lhs3);
+        f->chained2 = false;
     }
 
     action append2 {
-        f->lhs2 = f->binary(move(f->lhs2), move(f->lhs3));
+        f->lhs2 = f->binary(move(f->lhs2), move(f->lhs3), f->chained2);
+        f->chained2 = true;
     }
 
     action first1 {
@@ -123,12 +171,13 @@ namespace {
     }
 
     action append1 {
-        f->lhs1 = f->binary(move(f->lhs1), move(f->lhs2));
+        f->lhs1 = f->binary(move(f->lhs1), move(f->lhs2), false);
     }
 
     prio5 =
         TK_LITERAL @createLiteral |
         TK_VARIABLE @createVariable |
+        TK_EXPRESSION @reuseExpression |
         TK_OPEN_BRACE @createExpression;
 
     prio4 =
@@ -160,15 +209,16 @@ namespace {
 %% write data;
 
 namespace logic {
-    Parser::Parser(): _p(nullptr) { }
+    Parser::Parser(): _p(nullptr), _flatten(false) { }
 
-    Parser::Parser(const Token* p): _p(p) {
+    Parser::Parser(const Token* p, bool flatten): _p(p), _flatten(flatten) {
         %% write init;
     }
 
     auto Parser::Parse(const char hint[ ]) -> unique_ptr<Expression> {
         if (!_p)
             return nullptr;
+        LOGIC_STATS_TIME(stats::PARSER);
         vector<int> _stack;
         vector<StackFrame> frames(1);
         auto f = &frames[0];
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "profile.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include "dependency_visitor.h"
+#include "exception.h"
+#include "program_visitor.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    enum Chain {
+        NO_CHAIN,
+        AND_CHAIN,
+        OR_CHAIN,
+    };
+
+    using Lanes = vector<uint64_t>;
+    // A number per lane, bit-sliced: bit `k` of the number of lane `l` is bit `l % 64` of
+    // `counter[k][l / 64]`.
+    using Counter = vector<Lanes>;
+
+    uint64_t SplitMix64(uint64_t& state) {
+        uint64_t z = state += 0x9E3779B97F4A7C15;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t GetWordCount(uint64_t lanes) {
+        return (lanes + 63) / 64;
+    }
+
+    int PopCount(uint64_t x) {
+        int result = 0;
+        for (; x; x &= x - 1)
+            result++;
+        return result;
+    }
+
+    // `n` in the lanes of `mask`, 0 elsewhere.
+    auto Constant(uint64_t n, const Lanes& mask) -> Counter {
+        Counter result;
+        for (; n; n >>= 1)
+            result.push_back(n & 0x1 ? mask : Lanes(mask.size()));
+        return result;
+    }
+
+    // `c += x` in the lanes of `mask`.
+    void Add(Counter& c, const Counter& x, const Lanes& mask) {
+        Lanes carry(mask.size());
+        bool carries = false;
+        for (size_t k = 0; k < x.size() || carries; k++) {
+            if (k == c.size())
+                c.emplace_back(mask.size());
+            carries = false;
+            for (size_t w = 0; w < mask.size(); w++) {
+                auto a = c[k][w], b = k < x.size() ? x[k][w] & mask[w] : 0;
+                c[k][w] = a ^ b ^ carry[w];
+                carry[w] = (a & b) | (carry[w] & (a ^ b));
+                carries = carries || carry[w];
+            }
+        }
+    }
+
+    // The sum of the numbers of the lanes of `mask`.
+    uint64_t Sum(const Counter& c, const Lanes& mask) {
+        uint64_t result = 0;
+        for (size_t k = 0; k < c.size(); k++) {
+            uint64_t n = 0;
+            for (size_t w = 0; w < mask.size(); w++)
+                n += PopCount(c[k][w] & mask[w]);
+            result += n << k;
+        }
+        return result;
+    }
+
+    Chain GetChain(const Expression* e) {
+        if (dynamic_cast<const And*>(e) || dynamic_cast<const NaryAnd*>(e))
+            return AND_CHAIN;
+        if (dynamic_cast<const Or*>(e) || dynamic_cast<const NaryOr*>(e))
+            return OR_CHAIN;
+        return NO_CHAIN;
+    }
+
+    auto GetVariables(const Expression& e) -> vector<string> {
+        DependencyVisitor visitor;
+        e.Traverse(&visitor);
+        return visitor.GetNames();
+    }
+
+    // The nodes of a chain of `&` (`|`) of any shape. Its operands are evaluated in the order they
+    // appear in, until the first one that decides the result; an inner node is evaluated when its
+    // first operand is reached.
+    struct ChainLayout {
+        // The chain's own nodes, the root first. Only `Replay::Reorder` changes them.
+        vector<Operator*> nodes;
+        // The operands, as the node and the index they are at, in the order they appear in.
+        vector<pair<Operator*, size_t>> slots;
+        // The number of inner nodes evaluated right before the operand at the same position.
+        vector<size_t> overheads;
+
+        explicit ChainLayout(const Operator* op) {
+            auto chain = GetChain(op);
+            nodes.push_back(const_cast<Operator*>(op));
+            vector<pair<Operator*, size_t>> stack{{nodes.back(), 0}};
+            while (!stack.empty()) {
+                auto node = stack.back().first;
+                auto i = stack.back().second++;
+                if (i == node->GetOperandCount()) {
+                    stack.pop_back();
+                    continue;
+                }
+                auto x = const_cast<Expression*>(node->GetOperand(i));
+                if (GetChain(x) == chain) {
+                    nodes.push_back(static_cast<Operator*>(x));
+                    stack.emplace_back(nodes.back(), 0);
+                    overheads.resize(slots.size() + 1);
+                    overheads[slots.size()]++;
+                } else
+                    slots.emplace_back(node, i);
+            }
+            overheads.resize(slots.size());
+        }
+
+        auto GetOrder() const -> vector<size_t> {
+            vector<size_t> order(slots.size());
+            for (size_t k = 0; k < order.size(); k++)
+                order[k] = k;
+            return order;
+        }
+    };
+
+    // Replays the evaluation of an expression on the profiled assignments that give values to
+    // all its variables, one lane per assignment.
+    class Replay {
+    public:
+        Replay(const Expression& e, const Profile& profile):
+            _variables(GetVariables(e)), _visitor(_variables) {
+            vector<Lanes> columns;
+            _count = profile.Select(_variables, &columns);
+            auto words = GetWordCount(_count);
+            _all.assign(words, ~uint64_t(0));
+            if (_count % 64)
+                _all.back() = (uint64_t(1) << _count % 64) - 1;
+            e.Traverse(&_visitor);
+            auto program = _visitor.GetResult();
+            _values.assign(program.GetSize(), Lanes(words));
+            vector<uint64_t> vars(_variables.size()), slots(program.GetSize());
+            for (size_t w = 0; w < words; w++) {
+                for (size_t i = 0; i < vars.size(); i++)
+                    vars[i] = columns[i][w];
+                program.Evaluate(vars.data(), slots.data());
+                for (size_t s = 0; s < slots.size(); s++)
+                    _values[s][w] = slots[s] & _all[w];
+            }
+        }
+
+        auto GetCount() const -> uint64_t {
+            return _count;
+        }
+
+        auto GetAll() const -> const Lanes& {
+            return _all;
+        }
+
+        // Returns the number of `Evaluate` calls made in every lane by evaluating `e`.
+        auto Count(const Expression* e) const -> Counter {
+            auto op = dynamic_cast<const Operator*>(e);
+            auto chain = GetChain(e);
+            if (!op || chain == NO_CHAIN) {
+                auto result = Constant(1, _all);
+                for (size_t i = 0; op && i < op->GetOperandCount(); i++)
+                    Add(result, Count(op->GetOperand(i)), _GetReached(op, i, _all));
+                return result;
+            }
+
+            ChainLayout parts(op);
+            vector<Counter> calls;
+            for (const auto& slot: parts.slots)
+                calls.push_back(Count(slot.first->GetOperand(slot.second)));
+            return _GetCalls(parts, _GetDecides(parts, chain), calls, parts.GetOrder());
+        }
+
+        // Reorders the chains of `e` to make fewer `Evaluate` calls in the lanes of `reached`, the
+        // ones `e` is evaluated in, and returns the number of calls made in every lane. A chain
+        // keeps its order unless the new one is cheaper in those lanes, so their sum never grows.
+        auto Reorder(Expression* e, const Lanes& reached) -> Counter {
+            auto op = dynamic_cast<Operator*>(e);
+            auto chain = GetChain(e);
+            if (!op || chain == NO_CHAIN) {
+                auto result = Constant(1, _all);
+                for (size_t i = 0; op && i < op->GetOperandCount(); i++) {
+                    // The tree is ours to change, so are its nodes.
+                    auto x = const_cast<Expression*>(op->GetOperand(i));
+                    Add(result, Reorder(x, _GetReached(op, i, reached)), _GetReached(op, i, _all));
+                }
+                if (op)
+                    op->ResetRepr();
+                return result;
+            }
+
+            // The order is picked with the operands as they are; each of them is then reordered
+            // for the lanes it is reached in under that order, which only makes it cheaper there.
+            ChainLayout parts(op);
+            auto n = parts.slots.size();
+            auto decides = _GetDecides(parts, chain);
+            vector<Counter> calls;
+            for (const auto& slot: parts.slots)
+                calls.push_back(Count(slot.first->GetOperand(slot.second)));
+
+            // Greedily, the operand with the fewest calls per lane it decides among the lanes
+            // still undecided goes next. The ones that decide nothing keep their order at the end.
+            vector<size_t> greedy;
+            vector<bool> used(n);
+            auto undecided = reached;
+            for (size_t step = 0; step < n; step++) {
+                auto best = n;
+                auto bestKey = numeric_limits<double>::infinity();
+                for (size_t j = 0; j < n; j++) {
+                    uint64_t decided = 0;
+                    for (size_t w = 0; !used[j] && w < undecided.size(); w++)
+                        decided += PopCount(decides[j][w] & undecided[w]);
+                    if (!decided)
+                        continue;
+                    auto key = double(Sum(calls[j], undecided)) / decided;
+                    if (key < bestKey) {
+                        best = j;
+                        bestKey = key;
+                    }
+                }
+                if (best == n)
+                    break;
+                used[best] = true;
+                greedy.push_back(best);
+                for (size_t w = 0; w < undecided.size(); w++)
+                    undecided[w] &= ~decides[best][w];
+            }
+            for (size_t j = 0; j < n; j++)
+                if (!used[j])
+                    greedy.push_back(j);
+            auto order = parts.GetOrder();
+            if (Sum(_GetCalls(parts, decides, calls, greedy), reached) <
+                    Sum(_GetCalls(parts, decides, calls, order), reached))
+                order = greedy;
+
+            undecided = reached;
+            for (auto j: order) {
+                const auto& slot = parts.slots[j];
+                calls[j] = Reorder(const_cast<Expression*>(slot.first->GetOperand(slot.second)),
+                    undecided);
+                for (size_t w = 0; w < undecided.size(); w++)
+                    undecided[w] &= ~decides[j][w];
+            }
+            auto result = _GetCalls(parts, decides, calls, order);
+
+            vector<unique_ptr<Expression>> operands;
+            for (const auto& slot: parts.slots)
+                operands.push_back(slot.first->ReplaceOperand(slot.second, nullptr));
+            for (size_t k = 0; k < n; k++) {
+                const auto& slot = parts.slots[k];
+                slot.first->ReplaceOperand(slot.second, move(operands[order[k]]));
+            }
+            for (auto node: parts.nodes)
+                node->ResetRepr();
+            return result;
+        }
+
+    private:
+        vector<string> _variables;
+        ProgramVisitor _visitor;
+        uint64_t _count;
+        Lanes _all;
+        // Values of the nodes, indexed by their slots. Reordering the operands of a chain only
+        // changes the values of its inner nodes, which are never looked up.
+        vector<Lanes> _values;
+
+        auto _GetValue(const Expression* e) const -> const Lanes& {
+            return _values[_visitor.GetSlot(e)];
+        }
+
+        // The lanes of `reached` the `i`-th operand of `op` is evaluated in. The second operand of
+        // `->` is only evaluated if the first one is true.
+        auto _GetReached(const Operator* op, size_t i, const Lanes& reached) const -> Lanes {
+            auto result = reached;
+            if (i && dynamic_cast<const Implication*>(op))
+                for (size_t w = 0; w < result.size(); w++)
+                    result[w] &= _GetValue(op->GetOperand(0))[w];
+            return result;
+        }
+
+        // The lanes every operand of the chain decides its result in.
+        auto _GetDecides(const ChainLayout& parts, Chain chain) const -> vector<Lanes> {
+            vector<Lanes> result;
+            for (const auto& slot: parts.slots) {
+                result.push_back(_GetValue(slot.first->GetOperand(slot.second)));
+                if (chain == AND_CHAIN)
+                    for (size_t w = 0; w < _all.size(); w++)
+                        result.back()[w] ^= _all[w];
+            }
+            return result;
+        }
+
+        // The calls made by the chain in every lane with the operands in `order`, given the calls
+        // made by each of them.
+        auto _GetCalls(
+            const ChainLayout& parts,
+            const vector<Lanes>& decides,
+            const vector<Counter>& calls,
+            const vector<size_t>& order
+        ) const -> Counter {
+            auto result = Constant(1, _all);
+            auto reached = _all;
+            for (size_t k = 0; k < order.size(); k++) {
+                Add(result, Constant(parts.overheads[k], reached), reached);
+                Add(result, calls[order[k]], reached);
+                for (size_t w = 0; w < reached.size(); w++)
+                    reached[w] &= ~decides[order[k]][w];
+            }
+            return result;
+        }
+    };
+}
+
+namespace logic {
+    Profile::Profile(uint64_t maxAssignments): _maxAssignments(maxAssignments) { }
+
+    void Profile::Record(const vector<string>& variables, const vector<vector<bool>>& assignments) {
+        vector<Column*> columns;
+        for (const auto& name: variables) {
+            auto& column = _columns[name];
+            column.values.resize(GetWordCount(_count));
+            column.known.resize(GetWordCount(_count));
+            columns.push_back(&column);
+        }
+        for (const auto& assignment: assignments) {
+            // Reservoir sampling: once the profile is full, the `n`-th assignment is kept with
+            // probability `_maxAssignments / n`, in place of a random kept one.
+            auto lane = _count;
+            auto state = ++_recorded;
+            if (_count < _maxAssignments)
+                _Resize(_count + 1);
+            else if ((lane = SplitMix64(state) % _recorded) >= _maxAssignments)
+                continue;
+            auto bit = uint64_t(1) << (lane & 0x3F);
+            for (auto& entry: _columns) {
+                entry.second.values[lane >> 6] &= ~bit;
+                entry.second.known[lane >> 6] &= ~bit;
+            }
+            for (size_t i = 0; i < columns.size(); i++) {
+                columns[i]->known[lane >> 6] |= bit;
+                if (assignment[i])
+                    columns[i]->values[lane >> 6] |= bit;
+            }
+        }
+    }
+
+    auto Profile::GetAssignmentCount() const -> uint64_t {
+        return _count;
+    }
+
+    auto Profile::GetRecordedCount() const -> uint64_t {
+        return _recorded;
+    }
+
+    auto Profile::Select(const vector<string>& variables, vector<vector<uint64_t>>* columns) const
+        -> uint64_t {
+        columns->assign(variables.size(), { });
+        vector<const Column*> selected;
+        for (const auto& name: variables) {
+            auto it = _columns.find(name);
+            if (it == _columns.end())
+                return 0;
+            selected.push_back(&it->second);
+        }
+        uint64_t n = 0;
+        auto words = GetWordCount(_count);
+        for (size_t w = 0; w < words; w++) {
+            auto known = w + 1 < words || !(_count & 0x3F) ?
+                ~uint64_t(0) : (uint64_t(1) << (_count & 0x3F)) - 1;
+            for (auto column: selected)
+                known &= column->known[w];
+            if (!~known && !(n & 0x3F)) {
+                for (size_t i = 0; i < selected.size(); i++)
+                    (*columns)[i].push_back(selected[i]->values[w]);
+                n += 64;
+                continue;
+            }
+            for (uint32_t bit = 0; known; bit++, known >>= 1) {
+                if (!(known & 0x1))
+                    continue;
+                for (size_t i = 0; i < selected.size(); i++) {
+                    if (!(n & 0x3F))
+                        (*columns)[i].push_back(0);
+                    (*columns)[i].back() |= (selected[i]->values[w] >> bit & 0x1) << (n & 0x3F);
+                }
+                n++;
+            }
+        }
+        return n;
+    }
+
+    void Profile::Save(ostream& os) const {
+        os << _recorded << '\n';
+        string line;
+        for (const auto& entry: _columns) {
+            line = entry.first + '\t';
+            for (uint64_t k = 0; k < _count; k++) {
+                const auto& column = entry.second;
+                if (!(column.known[k >> 6] >> (k & 0x3F) & 0x1))
+                    line += '-';
+                else
+                    line += column.values[k >> 6] >> (k & 0x3F) & 0x1 ? '1' : '0';
+            }
+            os << line << '\n';
+        }
+    }
+
+    void Profile::Load(istream& is) {
+        string line;
+        if (!getline(is, line) || line.empty() || line.size() > 19 ||
+                line.find_first_not_of("0123456789") != string::npos)
+            throw ProfileFormatError(1);
+        uint64_t recorded = stoull(line);
+        map<string, string> lines;
+        size_t count = 0;
+        for (size_t n = 2; getline(is, line); n++) {
+            auto tab = line.find('\t');
+            if (tab == string::npos || !tab ||
+                    line.find_first_not_of("01-", tab + 1) != string::npos ||
+                    (n > 2 && line.size() - tab - 1 != count))
+                throw ProfileFormatError(n);
+            count = line.size() - tab - 1;
+            if (count > min(recorded, _maxAssignments) ||
+                    !lines.emplace(line.substr(0, tab), line.substr(tab + 1)).second)
+                throw ProfileFormatError(n);
+        }
+
+        _count = 0;
+        _recorded = recorded;
+        _columns.clear();
+        _Resize(count);
+        for (const auto& entry: lines) {
+            auto& column = _columns[entry.first];
+            column.values.resize(GetWordCount(_count));
+            column.known.resize(GetWordCount(_count));
+            for (size_t k = 0; k < count; k++) {
+                auto bit = uint64_t(1) << (k & 0x3F);
+                if (entry.second[k] != '-')
+                    column.known[k >> 6] |= bit;
+                if (entry.second[k] == '1')
+                    column.values[k >> 6] |= bit;
+            }
+        }
+    }
+
+    void Profile::_Resize(uint64_t count) {
+        _count = count;
+        for (auto& entry: _columns) {
+            entry.second.values.resize(GetWordCount(_count));
+            entry.second.known.resize(GetWordCount(_count));
+        }
+    }
+
+    auto ReorderOperands(Expression& e, const Profile& profile) -> MeasuredCost {
+        Replay replay(e, profile);
+        MeasuredCost result = { 0, 0 };
+        if (!replay.GetCount())
+            return result;
+        double n = replay.GetCount();
+        result.before = Sum(replay.Count(&e), replay.GetAll()) / n;
+        result.after = Sum(replay.Reorder(&e, replay.GetAll()), replay.GetAll()) / n;
+        return result;
+    }
+}
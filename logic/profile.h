@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "expression.h"
+
+namespace logic {
+    // A sample workload: up to a fixed number of the assignments recorded so far, kept bit-sliced
+    // per variable. Once it is full, a new assignment replaces a random kept one with the
+    // probability that keeps the sample uniform over all the recorded ones, so the profile does not
+    // grow with the workload. Evaluation of any formula over the recorded variables can be replayed
+    // on it exactly, so the cost of an order of operands is measured with the correlations between
+    // the operands intact rather than estimated.
+    class Profile {
+    public:
+        static const uint64_t DEFAULT_MAX_ASSIGNMENTS = uint64_t(1) << 14;
+
+        explicit Profile(uint64_t maxAssignments = DEFAULT_MAX_ASSIGNMENTS);
+        // Records the assignments; `assignments[k][i]` is the value of `variables[i]` in the `k`-th
+        // one. The other variables are unknown in them.
+        void Record(
+            const std::vector<std::string>& variables,
+            const std::vector<std::vector<bool>>& assignments
+        );
+        // The number of assignments kept.
+        auto GetAssignmentCount() const -> uint64_t;
+        // The number of assignments recorded, kept or not.
+        auto GetRecordedCount() const -> uint64_t;
+        // Packs the kept assignments that give values to all the `variables`, 64 to a word: bit
+        // `k % 64` of `columns[i][k / 64]` is the value of `variables[i]` in the `k`-th of them.
+        // Returns their number.
+        auto Select(
+            const std::vector<std::string>& variables, std::vector<std::vector<uint64_t>>* columns
+        ) const -> uint64_t;
+
+        // The number of assignments recorded on the first line, then one line per variable: the
+        // name and, after a tab, its value in every kept assignment (`0`, `1`, or `-` if unknown).
+        void Save(std::ostream&) const;
+        // Replaces this profile with a saved one, which may keep no more assignments than this one.
+        void Load(std::istream&);
+
+    private:
+        struct Column {
+            // Bit `k % 64` of word `k / 64` stands for the `k`-th assignment.
+            std::vector<uint64_t> values, known;
+        };
+
+        uint64_t _maxAssignments;
+        uint64_t _count = 0, _recorded = 0;
+        std::map<std::string, Column> _columns;
+
+        void _Resize(uint64_t count);
+    };
+
+    // Numbers of `Evaluate` calls per evaluation of the whole expression, averaged over the
+    // assignments of the profile. Both are 0 if no assignment gives values to all its variables.
+    struct MeasuredCost {
+        double before, after;
+    };
+
+    // Reorders the operands of every chain of `&` (`|`) to reduce the number of `Evaluate` calls
+    // over the profiled assignments. Operands are picked greedily, the one with the fewest calls
+    // per assignment it decides (makes false for `&`, true for `|`) among the ones still undecided
+    // first, counting only the assignments the chain is reached in; a chain keeps its order if that
+    // is not cheaper there, so the cost never grows. Chains keep their shape; only the operands are
+    // moved. Memory is proportional to the size of the expression times the number of assignments
+    // kept.
+    auto ReorderOperands(Expression&, const Profile&) -> MeasuredCost;
+}
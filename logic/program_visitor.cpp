@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "program_visitor.h"
+#include "exception.h"
+#include "expression.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    BitProgram::Opcode GetOpcode(const Expression* e) {
+        if (dynamic_cast<const Not*>(e))
+            return BitProgram::OP_NOT;
+        if (dynamic_cast<const And*>(e))
+            return BitProgram::OP_AND;
+        if (dynamic_cast<const Or*>(e))
+            return BitProgram::OP_OR;
+        if (dynamic_cast<const Xor*>(e))
+            return BitProgram::OP_XOR;
+        if (dynamic_cast<const Implication*>(e))
+            return BitProgram::OP_IMPLICATION;
+        if (dynamic_cast<const NaryAnd*>(e))
+            return BitProgram::OP_NARY_AND;
+        if (dynamic_cast<const NaryOr*>(e))
+            return BitProgram::OP_NARY_OR;
+        if (dynamic_cast<const NaryXor*>(e))
+            return BitProgram::OP_NARY_XOR;
+        return BitProgram::OP_EQUIVALENCE;
+    }
+}
+
+namespace logic {
+    const uint32_t ProgramVisitor::UNDECLARED;
+
+    ProgramVisitor::ProgramVisitor(const vector<string>& variables): _variables(variables) { }
+
+    void ProgramVisitor::Visit(const Expression* e) {
+        BitProgram::Instruction ins;
+        if (auto c = dynamic_cast<const Const*>(e))
+            ins = { BitProgram::OP_CONST, c->GetValue(), 0 };
+        else if (auto var = dynamic_cast<const Variable*>(e)) {
+            auto index = _GetIndex(var);
+            if (index == UNDECLARED)
+                throw UndeclaredVariableError(var->GetName());
+            ins = { BitProgram::OP_VARIABLE, index, 0 };
+        } else if (auto nary = dynamic_cast<const NaryOp*>(e)) {
+            auto count = nary->GetOperandCount();
+            auto first = _program.AppendOperands(&_stack[_stack.size() - count], count);
+            ins = { GetOpcode(e), first, uint32_t(count) };
+            _stack.resize(_stack.size() - count);
+        } else if (dynamic_cast<const UnaryOp*>(e)) {
+            ins = { GetOpcode(e), _stack.back(), 0 };
+            _stack.pop_back();
+        } else {
+            ins = { GetOpcode(e), _stack[_stack.size() - 2], _stack.back() };
+            _stack.resize(_stack.size() - 2);
+        }
+        auto slot = _program.Append(ins);
+        _stack.push_back(slot);
+        _slots.emplace(e, slot);
+    }
+
+    bool ProgramVisitor::HasSlot(const Expression* e) const {
+        return _slots.count(e) != 0;
+    }
+
+    size_t ProgramVisitor::GetSlot(const Expression* e) const {
+        return _slots.at(e);
+    }
+
+    auto ProgramVisitor::GetResult() -> BitProgram {
+        _stack.clear();
+        return move(_program);
+    }
+
+    uint32_t ProgramVisitor::_GetIndex(const Variable* var) {
+        const auto& symbols = var->GetSymbolTable();
+        if (&symbols != _symbols) {
+            _symbols = &symbols;
+            _indices.clear();
+            for (size_t i = 0; i < _variables.size(); i++) {
+                auto symbol = symbols.Find(_variables[i]);
+                if (symbol == SymbolTable::NONE)
+                    continue;
+                if (symbol >= _indices.size())
+                    _indices.resize(symbol + 1, UNDECLARED);
+                _indices[symbol] = i;
+            }
+        }
+        auto symbol = var->GetSymbol();
+        return symbol < _indices.size() ? _indices[symbol] : UNDECLARED;
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bit_program.h"
+#include "symbol_table.h"
+#include "visitor.h"
+
+namespace logic {
+    class Variable;
+
+    // Compiles the traversed expression into a `BitProgram`. Variables are numbered after their
+    // position in the list passed to the constructor.
+    class ProgramVisitor: public Visitor {
+    public:
+        explicit ProgramVisitor(const std::vector<std::string>& variables);
+        void Visit(const Expression*);
+        bool HasSlot(const Expression*) const;
+        size_t GetSlot(const Expression*) const;
+        auto GetResult() -> BitProgram;
+
+    private:
+        static const uint32_t UNDECLARED = uint32_t(-1);
+
+        BitProgram _program;
+        std::vector<std::string> _variables;
+        // Variable numbers indexed by symbols of `_symbols`.
+        const SymbolTable* _symbols = nullptr;
+        std::vector<uint32_t> _indices;
+        std::unordered_map<const Expression*, size_t> _slots;
+        std::vector<uint32_t> _stack;
+
+        uint32_t _GetIndex(const Variable*);
+    };
+}
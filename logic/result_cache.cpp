@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "result_cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "dependency_visitor.h"
+#include "subset_visitor.h"
+#include "truth_table.h"
+#include "../make_unique.h"
+
+using namespace std;
+
+namespace {
+    const char MAGIC[8] = {'L', 'O', 'G', 'I', 'C', 'R', 'C', '\0'};
+    const uint32_t VERSION = 1;
+    const uint32_t ENDIANNESS_MARK = 0x01020304;
+    const char EXTENSION[ ] = ".lrc";
+    const size_t EXTENSION_SIZE = sizeof EXTENSION - 1;
+    const size_t MAX_VARIABLES = 40;
+
+    // The header is followed by the table (block-major: the words of all the columns for rows
+    // `[0, 64)`, then for rows `[64, 128)` and so on), the model counts, the end offsets of the
+    // strings and the strings (the canonical form of the expression, then those of the columns).
+    // All the numbers are in the byte order of the machine that wrote the file.
+    struct Header {
+        char magic[8];
+        uint32_t version, endianness;
+        uint64_t fileSize;
+        uint64_t variableCount, columnCount;
+        uint64_t textSize;
+    };
+
+    struct Layout {
+        uint64_t counts, ends, text, size;
+    };
+
+    uint64_t GetWordCount(uint64_t variableCount) {
+        return variableCount < 6 ? 1 : uint64_t(1) << (variableCount - 6);
+    }
+
+    auto GetLayout(uint64_t variableCount, uint64_t columnCount, uint64_t textSize) -> Layout {
+        Layout layout;
+        auto tableWords = GetWordCount(variableCount) * columnCount;
+        layout.counts = sizeof(Header) + tableWords * sizeof(uint64_t);
+        layout.ends = layout.counts + columnCount * sizeof(uint64_t);
+        layout.text = layout.ends + (columnCount + 1) * sizeof(uint64_t);
+        layout.size = layout.text + textSize;
+        return layout;
+    }
+
+    auto GetHeader(const char* data) -> const Header& {
+        return *reinterpret_cast<const Header*>(data);
+    }
+
+    auto GetLayout(const char* data) -> Layout {
+        const auto& header = GetHeader(data);
+        return GetLayout(header.variableCount, header.columnCount, header.textSize);
+    }
+
+    auto GetWords(const char* data, uint64_t offset) -> const uint64_t* {
+        return reinterpret_cast<const uint64_t*>(data + offset);
+    }
+
+    int PopCount(uint64_t x) {
+        int result = 0;
+        for (; x; x &= x - 1)
+            result++;
+        return result;
+    }
+
+    auto ToString(const logic::Expression& e) -> string {
+        ostringstream ss;
+        e.ToString(ss);
+        return ss.str();
+    }
+
+    // Returns a copy of the expression whose variables are `symbols` `0`, `1`, ... in the order of
+    // the names of the original ones.
+    auto Rename(const logic::Expression& e, logic::SymbolTable& symbols)
+        -> unique_ptr<logic::Expression> {
+        logic::DependencyVisitor dVisitor;
+        e.Traverse(&dVisitor);
+        auto names = dVisitor.GetNames();
+        for (size_t i = 0; i < names.size(); i++)
+            symbols.Intern('v' + to_string(i));
+
+        auto rename = [&](const logic::Expression* x) -> unique_ptr<logic::Expression> {
+            auto variable = dynamic_cast<const logic::Variable*>(x);
+            if (!variable)
+                return nullptr;
+            auto rank = lower_bound(begin(names), end(names), variable->GetName()) - begin(names);
+            return make_unique<logic::Variable>(logic::SymbolId(rank), symbols);
+        };
+        auto result = e.Clone();
+        if (auto variable = rename(result.get()))
+            return variable;
+        vector<logic::Operator*> stack;
+        if (auto op = dynamic_cast<logic::Operator*>(result.get()))
+            stack.push_back(op);
+        while (!stack.empty()) {
+            auto op = stack.back();
+            stack.pop_back();
+            for (size_t i = 0; i < op->GetOperandCount(); i++) {
+                // The copy is ours, so its operands may be changed.
+                auto x = const_cast<logic::Expression*>(op->GetOperand(i));
+                if (auto variable = rename(x))
+                    op->ReplaceOperand(i, move(variable));
+                else if (auto child = dynamic_cast<logic::Operator*>(x))
+                    stack.push_back(child);
+            }
+        }
+        return result;
+    }
+
+    // The renamed expression with its columns: what an entry is made of.
+    struct CanonicalExpression {
+        logic::SymbolTable symbols;
+        unique_ptr<logic::Expression> expression;
+        vector<string> variables;
+        vector<const logic::Expression*> columns;
+        string text;
+        vector<string> columnTexts;
+
+        explicit CanonicalExpression(const logic::Expression& e): expression(Rename(e, symbols)) {
+            for (size_t i = 0; i < symbols.GetSize(); i++)
+                variables.push_back(symbols.GetName(logic::SymbolId(i)));
+            text = ToString(*expression);
+            logic::SubsetVisitor sVisitor;
+            expression->Traverse(&sVisitor);
+            for (auto x: sVisitor.GetResult())
+                if (dynamic_cast<const logic::Operator*>(x)) {
+                    columns.push_back(x);
+                    columnTexts.push_back(ToString(*x));
+                }
+        }
+
+        uint64_t GetTextSize() const {
+            uint64_t result = text.size();
+            for (const auto& s: columnTexts)
+                result += s.size();
+            return result;
+        }
+    };
+
+    // Files are named after the hash of the canonical form and the number of columns, which
+    // differs between flattened and binary trees printed the same way.
+    auto GetPath(const string& directory, const CanonicalExpression& key) -> string {
+        ostringstream ss;
+        ss << directory << '/' << hex << setw(16) << setfill('0') <<
+            logic::HashCanonical(key.text) << dec << '-' << key.columns.size() << EXTENSION;
+        return ss.str();
+    }
+
+    bool Matches(const char* data, size_t size, const CanonicalExpression& key) {
+        const auto& header = GetHeader(data);
+        if (size < sizeof(Header) || memcmp(header.magic, MAGIC, sizeof MAGIC) ||
+                header.version != VERSION || header.endianness != ENDIANNESS_MARK ||
+                header.fileSize != size || header.variableCount != key.variables.size() ||
+                header.columnCount != key.columns.size() || header.textSize != key.GetTextSize() ||
+                GetLayout(data).size != size)
+            return false;
+        auto layout = GetLayout(data);
+        auto ends = GetWords(data, layout.ends);
+        auto text = data + layout.text;
+        if (ends[0] != key.text.size() || key.text.compare(0, string::npos, text, ends[0]))
+            return false;
+        for (size_t j = 0; j < key.columns.size(); j++) {
+            const auto& s = key.columnTexts[j];
+            if (ends[j + 1] != ends[j] + s.size() ||
+                    s.compare(0, string::npos, text + ends[j], s.size()))
+                return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    void Write(ofstream& out, const T* data, size_t count) {
+        out.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+}
+
+namespace logic {
+    const uint64_t ResultCache::DEFAULT_MAX_SIZE;
+
+    auto Canonicalize(const Expression& e) -> string {
+        SymbolTable symbols;
+        return ToString(*Rename(e, symbols));
+    }
+
+    uint64_t HashCanonical(const string& text) {
+        uint64_t h = 0xCBF29CE484222325;
+        for (char c: text)
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3;
+        return h;
+    }
+
+    ResultCache::Entry::Entry(const char* data, size_t size): _data(data), _size(size) { }
+
+    ResultCache::Entry::~Entry() {
+        munmap(const_cast<char*>(_data), _size);
+    }
+
+    size_t ResultCache::Entry::GetVariableCount() const {
+        return GetHeader(_data).variableCount;
+    }
+
+    size_t ResultCache::Entry::GetColumnCount() const {
+        return GetHeader(_data).columnCount;
+    }
+
+    uint64_t ResultCache::Entry::GetRowCount() const {
+        return uint64_t(1) << GetVariableCount();
+    }
+
+    auto ResultCache::Entry::GetColumn(size_t column) const -> string {
+        auto layout = GetLayout(_data);
+        auto ends = GetWords(_data, layout.ends);
+        return string(_data + layout.text + ends[column], ends[column + 1] - ends[column]);
+    }
+
+    uint64_t ResultCache::Entry::GetModelCount(size_t column) const {
+        return GetWords(_data, GetLayout(_data).counts)[column];
+    }
+
+    uint64_t ResultCache::Entry::GetBlock(uint64_t block, uint64_t columns[ ]) const {
+        auto n = GetVariableCount(), c = GetColumnCount();
+        if (block >= GetWordCount(n)) {
+            fill_n(columns, c, 0);
+            return 0;
+        }
+        auto words = GetWords(_data, sizeof(Header)) + block * c;
+        copy(words, words + c, columns);
+        return n >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << n)) - 1;
+    }
+
+    ResultCache::ResultCache(const string& directory, uint64_t maxSize):
+        _directory(directory), _maxSize(maxSize) {
+        mkdir(_directory.c_str(), 0777);
+    }
+
+    auto ResultCache::Find(const Expression& e) const -> unique_ptr<Entry> {
+        CanonicalExpression key(e);
+        if (key.variables.size() > MAX_VARIABLES)
+            return nullptr;
+        auto path = GetPath(_directory, key);
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat info;
+        void* data = MAP_FAILED;
+        if (!fstat(fd, &info) && size_t(info.st_size) >= sizeof(Header))
+            data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return nullptr;
+        unique_ptr<Entry> entry(new Entry(static_cast<const char*>(data), info.st_size));
+        if (!Matches(entry->_data, entry->_size, key))
+            return nullptr;
+        // Marks the file as recently used.
+        utimes(path.c_str(), nullptr);
+        return entry;
+    }
+
+    bool ResultCache::Store(const Expression& e) const {
+        CanonicalExpression key(e);
+        auto n = key.variables.size(), c = key.columns.size();
+        if (n > MAX_VARIABLES)
+            return false;
+        auto layout = GetLayout(n, c, key.GetTextSize());
+        if (layout.size > _maxSize)
+            return false;
+
+        auto path = GetPath(_directory, key);
+        auto temporary = path + ".tmp" + to_string(getpid());
+        {
+            ofstream out(temporary, ios::binary);
+            Header header = { };
+            memcpy(header.magic, MAGIC, sizeof MAGIC);
+            header.version = VERSION;
+            header.endianness = ENDIANNESS_MARK;
+            header.fileSize = layout.size;
+            header.variableCount = n;
+            header.columnCount = c;
+            header.textSize = key.GetTextSize();
+            Write(out, &header, 1);
+
+            vector<uint64_t> counts(c);
+            if (c) {
+                TruthTable table(key.variables, key.columns);
+                vector<uint64_t> words(c);
+                for (uint64_t block = 0, count = GetWordCount(n); block < count; block++) {
+                    table.GetBlock(block, words.data());
+                    for (size_t j = 0; j < c; j++)
+                        counts[j] += PopCount(words[j]);
+                    Write(out, words.data(), c);
+                }
+            }
+            Write(out, counts.data(), c);
+
+            vector<uint64_t> ends{key.text.size()};
+            for (const auto& s: key.columnTexts)
+                ends.push_back(ends.back() + s.size());
+            Write(out, ends.data(), ends.size());
+            out << key.text;
+            for (const auto& s: key.columnTexts)
+                out << s;
+            if (!out.flush()) {
+                out.close();
+                remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (rename(temporary.c_str(), path.c_str())) {
+            remove(temporary.c_str());
+            return false;
+        }
+        _Evict(path);
+        return true;
+    }
+
+    void ResultCache::_Evict(const string& keep) const {
+        struct File {
+            time_t time;
+            string path;
+            uint64_t size;
+        };
+
+        DIR* dir = opendir(_directory.c_str());
+        if (!dir)
+            return;
+        vector<File> files;
+        uint64_t total = 0;
+        while (auto d = readdir(dir)) {
+            string name = d->d_name;
+            struct stat info;
+            if (name.size() <= EXTENSION_SIZE ||
+                    name.compare(name.size() - EXTENSION_SIZE, EXTENSION_SIZE, EXTENSION))
+                continue;
+            auto path = _directory + '/' + name;
+            if (stat(path.c_str(), &info))
+                continue;
+            total += info.st_size;
+            if (path != keep)
+                files.push_back({info.st_mtime, path, uint64_t(info.st_size)});
+        }
+        closedir(dir);
+
+        sort(begin(files), end(files), [ ](const File& a, const File& b) {
+            return a.time < b.time || (a.time == b.time && a.path < b.path);
+        });
+        for (const auto& file: files) {
+            if (total <= _maxSize)
+                break;
+            // Another process may have removed it already; either way, it no longer takes space.
+            unlink(file.path.c_str());
+            total -= file.size;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "expression.h"
+
+namespace logic {
+    // The string representation of an expression with its variables renamed to `v0`, `v1`, ... in
+    // the order of their names. Formulas that differ only in spacing, operator spelling or variable
+    // names (as long as the names go in the same order) get the same canonical form, and, since
+    // the order of the variables is kept, the same truth table.
+    auto Canonicalize(const Expression&) -> std::string;
+    uint64_t HashCanonical(const std::string&);
+
+    // A directory of truth tables keyed by the canonical form of the expression. Every entry holds
+    // the table of the operator subexpressions of an expression (the columns `main` prints), their
+    // canonical forms and model counts, in one file that is used in place through `mmap`. Files are
+    // replaced atomically, so several processes may share a directory. When the directory grows
+    // larger than the limit, the least recently used files are removed.
+    class ResultCache {
+    public:
+        class Entry {
+        public:
+            Entry(const Entry&) = delete;
+            auto operator=(const Entry&) -> Entry& = delete;
+            ~Entry();
+
+            size_t GetVariableCount() const;
+            size_t GetColumnCount() const;
+            uint64_t GetRowCount() const;
+            auto GetColumn(size_t) const -> std::string;
+            // The number of rows where the column is true.
+            uint64_t GetModelCount(size_t column) const;
+            // Same as `TruthTable::GetBlock` (without filters).
+            uint64_t GetBlock(uint64_t block, uint64_t columns[ ]) const;
+
+        private:
+            friend class ResultCache;
+
+            const char* _data;
+            size_t _size;
+
+            Entry(const char* data, size_t size);
+        };
+
+        static const uint64_t DEFAULT_MAX_SIZE = uint64_t(1) << 30;
+
+        // Creates the directory if it does not exist.
+        explicit ResultCache(const std::string& directory, uint64_t maxSize = DEFAULT_MAX_SIZE);
+        // Returns `nullptr` if the expression is not cached.
+        auto Find(const Expression&) const -> std::unique_ptr<Entry>;
+        // Evaluates the table and writes it to the cache. Returns `false` if the table does not fit
+        // in the size limit or cannot be written.
+        bool Store(const Expression&) const;
+
+    private:
+        std::string _directory;
+        uint64_t _maxSize;
+
+        // Removes the least recently used files (except `keep`) until the directory fits in the
+        // limit.
+        void _Evict(const std::string& keep) const;
+    };
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "sampler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "program_visitor.h"
+
+using namespace std;
+
+namespace {
+    const uint32_t ONE = 0x10000;
+    const uint64_t WORDS_PER_CHUNK = 1024;
+    const double Z = 1.959963984540054;
+
+    uint64_t SplitMix64(uint64_t& state) {
+        uint64_t z = state += 0x9E3779B97F4A7C15;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256**.
+    class Random {
+    public:
+        Random(uint64_t seed, uint64_t stream) {
+            uint64_t x = seed ^ SplitMix64(stream);
+            for (auto& s: _s)
+                s = SplitMix64(x);
+        }
+
+        uint64_t operator()() {
+            uint64_t result = _Rotl(_s[1] * 5, 7) * 9;
+            uint64_t t = _s[1] << 17;
+            _s[2] ^= _s[0];
+            _s[3] ^= _s[1];
+            _s[1] ^= _s[2];
+            _s[0] ^= _s[3];
+            _s[2] ^= t;
+            _s[3] = _Rotl(_s[3], 45);
+            return result;
+        }
+
+        // Every bit is set with probability `p / 2 ** 16`: the bits of `p` are applied from the
+        // lowest one, OR-ing a random word in for ones and AND-ing for zeros.
+        uint64_t Bernoulli(uint32_t p) {
+            if (p == ONE / 2)
+                return (*this)();
+            if (!p || p == ONE)
+                return p ? ~uint64_t(0) : 0;
+            int bits = 16;
+            for (; !(p & 0x1); p >>= 1)
+                bits--;
+            uint64_t result = 0;
+            for (; bits; bits--, p >>= 1)
+                result = p & 0x1 ? result | (*this)() : result & (*this)();
+            return result;
+        }
+
+    private:
+        uint64_t _s[4];
+
+        static uint64_t _Rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+    };
+
+    int PopCount(uint64_t x) {
+        int result = 0;
+        for (; x; x &= x - 1)
+            result++;
+        return result;
+    }
+}
+
+namespace logic {
+    Sampler::Sampler(const vector<string>& variables, const vector<const Expression*>& columns):
+        _biases(variables.size(), ONE / 2) {
+        ProgramVisitor visitor(variables);
+        for (auto it = columns.rbegin(); it != columns.rend(); ++it)
+            if (!visitor.HasSlot(*it))
+                (*it)->Traverse(&visitor);
+        for (auto e: columns)
+            _columns.push_back(visitor.GetSlot(e));
+        _program = visitor.GetResult();
+    }
+
+    void Sampler::SetBias(size_t variable, double probability) {
+        _biases.at(variable) = uint32_t(lround(min(max(probability, 0.), 1.) * ONE));
+    }
+
+    auto Sampler::Run(uint64_t samples, uint64_t seed, size_t threadCount) const
+        -> vector<Estimate> {
+        uint64_t words = (samples + 63) / 64;
+        uint64_t chunks = (words + WORDS_PER_CHUNK - 1) / WORDS_PER_CHUNK;
+        atomic<uint64_t> next(0);
+        vector<vector<uint64_t>> hits;
+
+        auto worker = [&](vector<uint64_t>* result) {
+            vector<uint64_t> vars(_biases.size()), slots(_program.GetSize());
+            for (uint64_t chunk; (chunk = next++) < chunks; ) {
+                Random random(seed, chunk);
+                uint64_t last = min((chunk + 1) * WORDS_PER_CHUNK, words);
+                for (uint64_t w = chunk * WORDS_PER_CHUNK; w < last; w++) {
+                    for (size_t i = 0; i < vars.size(); i++)
+                        vars[i] = random.Bernoulli(_biases[i]);
+                    _program.Evaluate(vars.data(), slots.data());
+                    uint64_t valid = w + 1 < words || !(samples & 0x3F) ?
+                        ~uint64_t(0) : (uint64_t(1) << (samples & 0x3F)) - 1;
+                    for (size_t j = 0; j < _columns.size(); j++)
+                        (*result)[j] += PopCount(slots[_columns[j]] & valid);
+                }
+            }
+        };
+
+        if (!threadCount)
+            threadCount = max(thread::hardware_concurrency(), 1u);
+        threadCount = max<uint64_t>(min<uint64_t>(threadCount, chunks), 1);
+        hits.assign(threadCount, vector<uint64_t>(_columns.size()));
+        vector<thread> threads;
+        for (size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker, &hits[i]);
+        worker(&hits[0]);
+        for (auto& t: threads)
+            t.join();
+
+        vector<Estimate> result;
+        double n = samples;
+        for (size_t j = 0; j < _columns.size(); j++) {
+            Estimate e = { 0, 0, 0, 1 };
+            for (const auto& h: hits)
+                e.hits += h[j];
+            if (samples) {
+                e.probability = e.hits / n;
+                double denominator = 1 + Z * Z / n;
+                double center = (e.probability + Z * Z / (2 * n)) / denominator;
+                double variance = e.probability * (1 - e.probability) / n + Z * Z / (4 * n * n);
+                double margin = Z * sqrt(variance) / denominator;
+                e.low = e.hits ? max(center - margin, 0.) : 0;
+                e.high = e.hits < samples ? min(center + margin, 1.) : 1;
+            }
+            result.push_back(e);
+        }
+        return result;
+    }
+}
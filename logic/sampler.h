@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bit_program.h"
+#include "expression.h"
+
+namespace logic {
+    // Estimates how often expressions are true under random assignments. Samples are drawn 64 per
+    // word and evaluated bit-sliced. The work is split into fixed chunks with their own PRNG
+    // streams, so the result depends only on the seed, not on the number of threads.
+    class Sampler {
+    public:
+        struct Estimate {
+            uint64_t hits;
+            double probability;
+            // 95% Wilson score interval.
+            double low, high;
+        };
+
+        Sampler(const std::vector<std::string>& variables,
+            const std::vector<const Expression*>& columns);
+        // Sets the probability of the variable being true (0.5 by default). The probability is
+        // rounded to a multiple of 2 ** -16.
+        void SetBias(size_t variable, double probability);
+        auto Run(uint64_t samples, uint64_t seed, size_t threadCount = 0) const
+            -> std::vector<Estimate>;
+
+    private:
+        BitProgram _program;
+        std::vector<size_t> _columns;
+        std::vector<uint32_t> _biases;
+    };
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+#include "specialization.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include "../make_unique.h"
+
+using namespace std;
+
+namespace {
+    using namespace logic;
+
+    class SymbolVisitor: public Visitor {
+    public:
+        void Visit(const Expression* e) {
+            if (auto variable = dynamic_cast<const Variable*>(e))
+                _symbols.insert(variable->GetSymbol());
+        }
+
+        auto GetResult() const -> vector<SymbolId> {
+            return vector<SymbolId>(begin(_symbols), end(_symbols));
+        }
+
+    private:
+        set<SymbolId> _symbols;
+    };
+
+    // Returns -1 if the expression is not a constant.
+    int GetConstValue(const Expression* e) {
+        auto c = dynamic_cast<const Const*>(e);
+        return c ? c->GetValue() : -1;
+    }
+
+    template <typename T>
+    auto CreateOperator(size_t, false_type) -> unique_ptr<Expression> {
+        return make_unique<T>();
+    }
+
+    template <typename T>
+    auto CreateOperator(size_t count, true_type) -> unique_ptr<Expression> {
+        return make_unique<T>(vector<unique_ptr<Expression>>(count));
+    }
+
+    // Owns the nodes of all residuals, one per distinct kind, value and operands, so equal
+    // subexpressions are one node. A pooled node does not own its operands: they are pooled too
+    // and may have many parents. Safe to use from several threads.
+    class Pool {
+    public:
+        Pool() = default;
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+        ~Pool();
+        auto GetConst(bool) -> const Expression*;
+        auto GetVariable(const Variable&) -> const Expression*;
+        // The operands have to be pooled.
+        template <typename T>
+        auto GetOperator(vector<const Expression*>&&) -> const Expression*;
+
+    private:
+        struct Key {
+            type_index kind;
+            const void* symbols;
+            size_t value;
+            vector<const Expression*> operands;
+
+            bool operator==(const Key& other) const {
+                return kind == other.kind && symbols == other.symbols && value == other.value &&
+                    operands == other.operands;
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const {
+                auto h = key.kind.hash_code() ^ hash<const void*>()(key.symbols) ^ key.value;
+                for (auto x: key.operands)
+                    h = h * 31 + hash<const Expression*>()(x);
+                return h;
+            }
+        };
+
+        mutex _mutex;
+        vector<unique_ptr<Expression>> _nodes;
+        unordered_map<Key, const Expression*, KeyHash> _index;
+
+        template <typename F>
+        auto _Get(Key&&, F create) -> const Expression*;
+    };
+
+    Pool::~Pool() {
+        for (auto& node: _nodes)
+            if (auto op = dynamic_cast<Operator*>(node.get()))
+                for (size_t i = 0; i < op->GetOperandCount(); i++)
+                    op->ReplaceOperand(i, nullptr).release();
+    }
+
+    auto Pool::GetConst(bool value) -> const Expression* {
+        return _Get(Key { typeid(Const), nullptr, value, { } }, [=]( ) {
+            return make_unique<Const>(value);
+        });
+    }
+
+    auto Pool::GetVariable(const Variable& variable) -> const Expression* {
+        const auto& symbols = variable.GetSymbolTable();
+        auto symbol = variable.GetSymbol();
+        return _Get(Key { typeid(Variable), &symbols, symbol, { } }, [&]( ) {
+            return make_unique<Variable>(symbol, symbols);
+        });
+    }
+
+    template <typename T>
+    auto Pool::GetOperator(vector<const Expression*>&& operands) -> const Expression* {
+        auto count = operands.size();
+        return _Get(Key { typeid(T), nullptr, 0, move(operands) }, [=]( ) {
+            return CreateOperator<T>(count, is_base_of<NaryOp, T>());
+        });
+    }
+
+    template <typename F>
+    auto Pool::_Get(Key&& key, F create) -> const Expression* {
+        lock_guard<mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it != end(_index))
+            return it->second;
+        // The node is created without operands, so nothing is freed twice if this throws.
+        _nodes.push_back(create());
+        auto node = _nodes.back().get();
+        if (auto op = dynamic_cast<Operator*>(node))
+            for (size_t i = 0; i < key.operands.size(); i++) {
+                auto x = const_cast<Expression*>(key.operands[i]);
+                op->ReplaceOperand(i, unique_ptr<Expression>(x));
+            }
+        _index.emplace(move(key), node);
+        return node;
+    }
+
+    // Specialises an expression into a pool, folding constants like `Expression::Specialize`.
+    // Subexpressions left untouched by an assignment come out as the pooled copies of the
+    // original ones, which all residuals share.
+    class Specializer: private Visitor {
+    public:
+        Specializer(const Expression&, Pool&);
+        auto Specialize(const Expression*, const Context&) const -> const Expression*;
+
+    private:
+        Pool& _pool;
+        unordered_map<const Expression*, const Expression*> _copies;
+
+        void Visit(const Expression*);
+        auto _Negate(const Expression*) const -> const Expression*;
+        // `empty` is the value of a chain without operands.
+        auto _Join(const Operator*, vector<const Expression*>&&, bool empty) const
+            -> const Expression*;
+        auto _Rebuild(const Operator*, vector<const Expression*>&&) const -> const Expression*;
+    };
+
+    Specializer::Specializer(const Expression& e, Pool& pool): _pool(pool) {
+        e.Traverse(this);
+    }
+
+    auto Specializer::Specialize(const Expression* e, const Context& context) const
+        -> const Expression* {
+        if (auto variable = dynamic_cast<const Variable*>(e)) {
+            auto value = context.Get(variable->GetSymbol());
+            return value < 0 ? _copies.at(e) : _pool.GetConst(value != 0);
+        }
+        auto op = dynamic_cast<const Operator*>(e);
+        if (!op)
+            return _copies.at(e);
+        if (dynamic_cast<const Not*>(op))
+            return _Negate(Specialize(op->GetOperand(0), context));
+
+        vector<const Expression*> operands;
+        if (dynamic_cast<const NaryOp*>(op)) {
+            bool isAnd = dynamic_cast<const NaryAnd*>(op), isOr = dynamic_cast<const NaryOr*>(op);
+            bool parity = false;
+            for (size_t i = 0; i < op->GetOperandCount(); i++) {
+                auto x = Specialize(op->GetOperand(i), context);
+                auto value = GetConstValue(x);
+                if (value < 0)
+                    operands.push_back(x);
+                else if ((isAnd && !value) || (isOr && value))
+                    return _pool.GetConst(value != 0);
+                else
+                    parity ^= value != 0;
+            }
+            auto result = _Join(op, move(operands), isAnd);
+            return parity && !isAnd && !isOr ? _Negate(result) : result;
+        }
+
+        auto a = Specialize(op->GetOperand(0), context), b = Specialize(op->GetOperand(1), context);
+        auto x = GetConstValue(a), y = GetConstValue(b);
+        if (dynamic_cast<const And*>(op)) {
+            if (!x || !y)
+                return _pool.GetConst(false);
+            if (x > 0)
+                return b;
+            if (y > 0)
+                return a;
+        } else if (dynamic_cast<const Or*>(op)) {
+            if (x > 0 || y > 0)
+                return _pool.GetConst(true);
+            if (!x)
+                return b;
+            if (!y)
+                return a;
+        } else if (dynamic_cast<const Xor*>(op)) {
+            if (x >= 0)
+                return x ? _Negate(b) : b;
+            if (y >= 0)
+                return y ? _Negate(a) : a;
+        } else if (dynamic_cast<const Implication*>(op)) {
+            if (!x || y > 0)
+                return _pool.GetConst(true);
+            if (x > 0)
+                return b;
+            if (!y)
+                return _Negate(a);
+        } else {
+            if (x >= 0)
+                return x ? b : _Negate(b);
+            if (y >= 0)
+                return y ? a : _Negate(a);
+        }
+        return _Rebuild(op, { a, b });
+    }
+
+    void Specializer::Visit(const Expression* e) {
+        const Expression* copy;
+        if (auto c = dynamic_cast<const Const*>(e))
+            copy = _pool.GetConst(c->GetValue());
+        else if (auto variable = dynamic_cast<const Variable*>(e))
+            copy = _pool.GetVariable(*variable);
+        else {
+            auto op = static_cast<const Operator*>(e);
+            vector<const Expression*> operands;
+            for (size_t i = 0; i < op->GetOperandCount(); i++)
+                operands.push_back(_copies.at(op->GetOperand(i)));
+            copy = _Rebuild(op, move(operands));
+        }
+        _copies.emplace(e, copy);
+    }
+
+    auto Specializer::_Negate(const Expression* x) const -> const Expression* {
+        auto value = GetConstValue(x);
+        if (value >= 0)
+            return _pool.GetConst(!value);
+        return _pool.GetOperator<Not>({ x });
+    }
+
+    auto Specializer::_Join(const Operator* op, vector<const Expression*>&& operands, bool empty)
+        const -> const Expression* {
+        if (operands.empty())
+            return _pool.GetConst(empty);
+        if (operands.size() == 1)
+            return operands[0];
+        return _Rebuild(op, move(operands));
+    }
+
+    // Returns the pooled node of the kind of `op` over the operands, which is the copy of `op` if
+    // they are the copies of its own operands.
+    auto Specializer::_Rebuild(const Operator* op, vector<const Expression*>&& operands) const
+        -> const Expression* {
+        auto copy = _copies.find(op);
+        if (copy != end(_copies) && operands.size() == op->GetOperandCount()) {
+            size_t i = 0;
+            while (i < operands.size() && operands[i] == _copies.at(op->GetOperand(i)))
+                i++;
+            if (i == operands.size())
+                return copy->second;
+        }
+        if (dynamic_cast<const Not*>(op))
+            return _pool.GetOperator<Not>(move(operands));
+        if (dynamic_cast<const And*>(op))
+            return _pool.GetOperator<And>(move(operands));
+        if (dynamic_cast<const Or*>(op))
+            return _pool.GetOperator<Or>(move(operands));
+        if (dynamic_cast<const Xor*>(op))
+            return _pool.GetOperator<Xor>(move(operands));
+        if (dynamic_cast<const Implication*>(op))
+            return _pool.GetOperator<Implication>(move(operands));
+        if (dynamic_cast<const NaryAnd*>(op))
+            return _pool.GetOperator<NaryAnd>(move(operands));
+        if (dynamic_cast<const NaryOr*>(op))
+            return _pool.GetOperator<NaryOr>(move(operands));
+        if (dynamic_cast<const NaryXor*>(op))
+            return _pool.GetOperator<NaryXor>(move(operands));
+        return _pool.GetOperator<Equivalence>(move(operands));
+    }
+}
+
+namespace logic {
+    auto SpecializeAll(const Expression& e, const vector<Context>& assignments, size_t threadCount)
+        -> vector<shared_ptr<const Expression>> {
+        SymbolVisitor visitor;
+        e.Traverse(&visitor);
+        auto symbols = visitor.GetResult();
+
+        // Only the values of the variables of the expression matter.
+        unordered_map<string, size_t> groups;
+        vector<size_t> groupOf, representatives;
+        for (size_t k = 0; k < assignments.size(); k++) {
+            string key;
+            for (auto symbol: symbols)
+                key += char(assignments[k].Get(symbol) + 1);
+            auto it = groups.emplace(move(key), representatives.size());
+            if (it.second)
+                representatives.push_back(k);
+            groupOf.push_back(it.first->second);
+        }
+
+        auto pool = make_shared<Pool>();
+        Specializer specializer(e, *pool);
+        vector<const Expression*> residuals(representatives.size());
+        atomic<size_t> next(0);
+        atomic<bool> failed(false);
+        exception_ptr error;
+        mutex errorMutex;
+        auto worker = [&]( ) {
+            try {
+                for (size_t i; !failed && (i = next.fetch_add(1)) < residuals.size(); )
+                    residuals[i] = specializer.Specialize(&e, assignments[representatives[i]]);
+            }
+            catch (...) {
+                lock_guard<mutex> lock(errorMutex);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        };
+        if (!threadCount)
+            threadCount = max(thread::hardware_concurrency(), 1u);
+        threadCount = min(threadCount, residuals.size());
+        vector<thread> threads;
+        for (size_t i = 1; i < threadCount; i++)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& t: threads)
+            t.join();
+        if (error)
+            rethrow_exception(error);
+
+        // Every residual keeps the whole pool alive.
+        vector<shared_ptr<const Expression>> result;
+        result.reserve(assignments.size());
+        for (auto group: groupOf)
+            result.emplace_back(pool, residuals[group]);
+        return result;
+    }
+}
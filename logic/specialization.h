@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "expression.h"
+
+namespace logic {
+    // Specialises the expression (see `Expression::Specialize`) for every partial assignment, in
+    // parallel. Assignments that agree on the variables of the expression are specialised once.
+    // The residuals form one DAG: equal subexpressions, and equal residuals, are one node, and the
+    // nodes live until the last residual is released. Shared nodes cache their representations, so
+    // residuals must not be printed from several threads at once. The expression must not be
+    // changed meanwhile.
+    auto SpecializeAll(const Expression&, const std::vector<Context>& assignments,
+        size_t threadCount = 0) -> std::vector<std::shared_ptr<const Expression>>;
+}
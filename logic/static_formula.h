@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+// A compile-time counterpart of `Lexer` + `Parser` for formulas known at build time:
+//
+//     constexpr auto rule = logic::MakeStaticFormula("a & (b | !c)");
+//     static_assert(rule.Evaluate(0x3), "");                  // a = 1, b = 1, c = 0
+//     bool Check(uint64_t mask) { return rule.Evaluate(mask); }
+//
+// `StaticEvaluator` (see below) turns such a formula into straight-line code.
+//
+// The grammar is that of `lexer.rl` and `parser.rl`. Lexical and syntax errors are reported at
+// compile time (as `LexicalError` and `SyntaxError` thrown from a constant expression). Variables
+// are numbered in lexicographic order of their names; bit `i` of an assignment is the value of
+// variable `i`. Requires C++14.
+
+#include <cstddef>
+#include <cstdint>
+#include "lexer.h"
+#include "parser.h"
+#include "token_id.h"
+
+namespace logic {
+    // Nodes are stored so that operands precede the operator; the last node is the root.
+    // `a` holds the value of a constant or the index of a variable.
+    struct StaticNode {
+        enum Opcode: uint8_t {
+            OP_CONST,
+            OP_VARIABLE,
+            OP_NOT,
+            OP_AND,
+            OP_OR,
+            OP_XOR,
+            OP_IMPLICATION,
+            OP_EQUIVALENCE,
+        };
+
+        Opcode opcode;
+        size_t a, b;
+    };
+
+    template <size_t N>
+    class StaticFormula {
+    public:
+        using Opcode = StaticNode::Opcode;
+        using Node = StaticNode;
+
+        static const size_t MAX_VARIABLES = 64;
+
+        constexpr explicit StaticFormula(const char (&text)[N]):
+            _text{ }, _nodes{ }, _size(0), _names{ }, _variableCount(0), _pos(0) {
+            for (size_t i = 0; i < N; i++)
+                _text[i] = text[i];
+            auto root = _Parse1();
+            if (_Scan() != TK_EOF)
+                throw SyntaxError(text);
+            (void)root;
+            _SortVariables();
+        }
+
+        constexpr size_t GetSize() const { return _size; }
+        constexpr const Node& GetNode(size_t i) const { return _nodes[i]; }
+        constexpr size_t GetVariableCount() const { return _variableCount; }
+
+        // Returns the index of a variable or -1 if the formula does not use it.
+        constexpr int GetVariableIndex(const char* name) const {
+            for (size_t i = 0; i < _variableCount; i++) {
+                size_t k = 0;
+                while (k < _names[i].length && name[k] == _text[_names[i].begin + k])
+                    k++;
+                if (k == _names[i].length && !name[k])
+                    return int(i);
+            }
+            return -1;
+        }
+
+        constexpr bool Evaluate(uint64_t assignment) const {
+            bool values[N] = { };
+            for (size_t i = 0; i < _size; i++) {
+                const auto& n = _nodes[i];
+                switch (n.opcode) {
+                case Node::OP_CONST:       values[i] = n.a;                         break;
+                case Node::OP_VARIABLE:    values[i] = assignment >> n.a & 0x1;     break;
+                case Node::OP_NOT:         values[i] = !values[n.a];                break;
+                case Node::OP_AND:         values[i] = values[n.a] && values[n.b];  break;
+                case Node::OP_OR:          values[i] = values[n.a] || values[n.b];  break;
+                case Node::OP_XOR:         values[i] = values[n.a] != values[n.b];  break;
+                case Node::OP_IMPLICATION: values[i] = !values[n.a] || values[n.b]; break;
+                case Node::OP_EQUIVALENCE: values[i] = values[n.a] == values[n.b];  break;
+                }
+            }
+            return values[_size - 1];
+        }
+
+    private:
+        struct Name {
+            size_t begin, length;
+        };
+
+        char _text[N];
+        Node _nodes[N];
+        size_t _size;
+        Name _names[MAX_VARIABLES];
+        size_t _variableCount;
+        size_t _pos;
+
+        static constexpr bool _IsSpace(char c) {
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        static constexpr bool _IsAlpha(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        }
+
+        static constexpr bool _IsAlnum(char c) {
+            return _IsAlpha(c) || (c >= '0' && c <= '9');
+        }
+
+        // Skips whitespace and returns the next token without consuming it.
+        constexpr TokenId _Scan(size_t* length = nullptr) {
+            const size_t end = N - 1;
+            while (_pos < end && _IsSpace(_text[_pos]))
+                _pos++;
+            size_t len = 1;
+            TokenId id = TK_EOF;
+            if (_pos == end || !_text[_pos])
+                len = 0;
+            else
+                switch (_text[_pos]) {
+                case '(': id = TK_OPEN_BRACE;  break;
+                case ')': id = TK_CLOSE_BRACE; break;
+                case '0': case '1': id = TK_LITERAL; break;
+                case '!': id = TK_NOT; break;
+                case '-':
+                    if (_pos + 1 < end && _text[_pos + 1] == '>') {
+                        id = TK_IMPLICATION;
+                        len = 2;
+                    } else
+                        id = TK_NOT;
+                    break;
+                case '&': case '*': id = TK_AND; break;
+                case '|': case '+': id = TK_OR;  break;
+                case '^': id = TK_XOR; break;
+                case '<':
+                    if (_pos + 2 < end && (_text[_pos + 1] == '-' || _text[_pos + 1] == '=') &&
+                            _text[_pos + 2] == '>') {
+                        id = TK_EQUIVALENCE;
+                        len = 3;
+                        break;
+                    }
+                    throw LexicalError(_text + _pos);
+                case '=':
+                    id = TK_EQUIVALENCE;
+                    if (_pos + 1 < end && _text[_pos + 1] == '=')
+                        len = 2;
+                    break;
+                default:
+                    if (!_IsAlpha(_text[_pos]))
+                        throw LexicalError(_text + _pos);
+                    id = TK_VARIABLE;
+                    while (_pos + len < end && _IsAlnum(_text[_pos + len]))
+                        len++;
+                }
+            if (length)
+                *length = len;
+            return id;
+        }
+
+        constexpr size_t _Append(Opcode opcode, size_t a, size_t b = 0) {
+            _nodes[_size] = Node{ opcode, a, b };
+            return _size++;
+        }
+
+        constexpr size_t _AddVariable(size_t begin, size_t length) {
+            for (size_t i = 0; i < _variableCount; i++) {
+                size_t k = 0;
+                if (_names[i].length == length)
+                    while (k < length && _text[_names[i].begin + k] == _text[begin + k])
+                        k++;
+                if (k == length && _names[i].length == length)
+                    return i;
+            }
+            if (_variableCount == MAX_VARIABLES)
+                throw SyntaxError(_text);
+            _names[_variableCount] = Name{ begin, length };
+            return _variableCount++;
+        }
+
+        constexpr size_t _Parse5() {
+            size_t length = 0;
+            switch (_Scan(&length)) {
+            case TK_LITERAL:
+                _pos += length;
+                return _Append(Node::OP_CONST, _text[_pos - 1] == '1');
+
+            case TK_VARIABLE:
+                _pos += length;
+                return _Append(Node::OP_VARIABLE, _AddVariable(_pos - length, length));
+
+            case TK_OPEN_BRACE: {
+                _pos += length;
+                auto result = _Parse1();
+                if (_Scan(&length) != TK_CLOSE_BRACE)
+                    throw SyntaxError(_text);
+                _pos += length;
+                return result;
+            }
+
+            default:
+                throw SyntaxError(_text);
+            }
+        }
+
+        constexpr size_t _Parse4() {
+            size_t length = 0, notCounter = 0;
+            while (_Scan(&length) == TK_NOT) {
+                _pos += length;
+                notCounter++;
+            }
+            auto result = _Parse5();
+            while (notCounter--)
+                result = _Append(Node::OP_NOT, result);
+            return result;
+        }
+
+        constexpr size_t _Parse3() {
+            auto lhs = _Parse4();
+            size_t length = 0;
+            while (_Scan(&length) == TK_AND) {
+                _pos += length;
+                auto rhs = _Parse4();
+                lhs = _Append(Node::OP_AND, lhs, rhs);
+            }
+            return lhs;
+        }
+
+        constexpr size_t _Parse2() {
+            auto lhs = _Parse3();
+            size_t length = 0;
+            for (auto id = _Scan(&length); id == TK_OR || id == TK_XOR; id = _Scan(&length)) {
+                _pos += length;
+                auto rhs = _Parse3();
+                lhs = _Append(id == TK_OR ? Node::OP_OR : Node::OP_XOR, lhs, rhs);
+            }
+            return lhs;
+        }
+
+        constexpr size_t _Parse1() {
+            auto lhs = _Parse2();
+            size_t length = 0;
+            for (auto id = _Scan(&length); id == TK_IMPLICATION || id == TK_EQUIVALENCE;
+                    id = _Scan(&length)) {
+                _pos += length;
+                auto rhs = _Parse2();
+                auto opcode = id == TK_IMPLICATION ? Node::OP_IMPLICATION : Node::OP_EQUIVALENCE;
+                lhs = _Append(opcode, lhs, rhs);
+            }
+            return lhs;
+        }
+
+        constexpr bool _Less(const Name& x, const Name& y) const {
+            for (size_t k = 0; k < x.length && k < y.length; k++)
+                if (_text[x.begin + k] != _text[y.begin + k])
+                    return _text[x.begin + k] < _text[y.begin + k];
+            return x.length < y.length;
+        }
+
+        // Renumbers the variables from the order of appearance to the lexicographic one.
+        constexpr void _SortVariables() {
+            size_t rank[MAX_VARIABLES] = { };
+            for (size_t i = 0; i < _variableCount; i++)
+                for (size_t j = 0; j < _variableCount; j++)
+                    if (_Less(_names[j], _names[i]))
+                        rank[i]++;
+            Name sorted[MAX_VARIABLES] = { };
+            for (size_t i = 0; i < _variableCount; i++)
+                sorted[rank[i]] = _names[i];
+            for (size_t i = 0; i < _variableCount; i++)
+                _names[i] = sorted[i];
+            for (size_t i = 0; i < _size; i++)
+                if (_nodes[i].opcode == Node::OP_VARIABLE)
+                    _nodes[i].a = rank[_nodes[i].a];
+        }
+    };
+
+    template <size_t N>
+    constexpr StaticFormula<N> MakeStaticFormula(const char (&text)[N]) {
+        return StaticFormula<N>(text);
+    }
+
+    // Unrolls a namespace-scope `constexpr` formula into straight-line code, one instantiation
+    // per node:
+    //
+    //     logic::StaticEvaluator<decltype(rule), rule>::Evaluate(mask)
+    template <
+        class F, F& formula, size_t i = formula.GetSize() - 1,
+        StaticNode::Opcode = formula.GetNode(i).opcode
+    >
+    struct StaticEvaluator;
+
+    template <class F, F& f, size_t i>
+    struct StaticEvaluator<F, f, i, StaticNode::OP_CONST> {
+        static constexpr bool Evaluate(uint64_t) {
+            return f.GetNode(i).a;
+        }
+    };
+
+    template <class F, F& f, size_t i>
+    struct StaticEvaluator<F, f, i, StaticNode::OP_VARIABLE> {
+        static constexpr bool Evaluate(uint64_t assignment) {
+            return assignment >> f.GetNode(i).a & 0x1;
+        }
+    };
+
+    template <class F, F& f, size_t i>
+    struct StaticEvaluator<F, f, i, StaticNode::OP_NOT> {
+        static constexpr bool Evaluate(uint64_t assignment) {
+            return !StaticEvaluator<F, f, f.GetNode(i).a>::Evaluate(assignment);
+        }
+    };
+
+#define LOGIC_STATIC_BINARY_EVALUATOR(opcode, expression)                                      \
+    template <class F, F& f, size_t i>                                                          \
+    struct StaticEvaluator<F, f, i, StaticNode::opcode> {                                       \
+        static constexpr bool Evaluate(uint64_t assignment) {                                   \
+            return expression;                                                                  \
+        }                                                                                       \
+                                                                                                \
+    private:                                                                                    \
+        static constexpr bool _A(uint64_t x) {                                                  \
+            return StaticEvaluator<F, f, f.GetNode(i).a>::Evaluate(x);                          \
+        }                                                                                       \
+                                                                                                \
+        static constexpr bool _B(uint64_t x) {                                                  \
+            return StaticEvaluator<F, f, f.GetNode(i).b>::Evaluate(x);                          \
+        }                                                                                       \
+    };
+
+    LOGIC_STATIC_BINARY_EVALUATOR(OP_AND, _A(assignment) && _B(assignment))
+    LOGIC_STATIC_BINARY_EVALUATOR(OP_OR, _A(assignment) || _B(assignment))
+    LOGIC_STATIC_BINARY_EVALUATOR(OP_XOR, _A(assignment) != _B(assignment))
+    LOGIC_STATIC_BINARY_EVALUATOR(OP_IMPLICATION, !_A(assignment) || _B(assignment))
+    LOGIC_STATIC_BINARY_EVALUATOR(OP_EQUIVALENCE, _A(assignment) == _B(assignment))
+
+#undef LOGIC_STATIC_BINARY_EVALUATOR
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "stats.h"
+
+#ifdef LOGIC_STATS
+#   include <atomic>
+#   include <cstdlib>
+#   include <new>
+
+    using namespace std;
+
+    namespace {
+        using namespace logic::stats;
+
+        const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+            "tokens",
+            "const_nodes",
+            "variable_nodes",
+            "not_nodes",
+            "and_nodes",
+            "or_nodes",
+            "xor_nodes",
+            "implication_nodes",
+            "equivalence_nodes",
+            "evaluations",
+            "bitsliced_evaluations",
+            "allocations",
+            "allocated_bytes",
+            "bytes_written",
+        };
+
+        const char* const TIMER_NAMES[TIMER_COUNT] = {
+            "lexer",
+            "parser",
+            "dependency_visitor",
+            "subset_visitor",
+            "op_count_visitor",
+            "evaluation",
+            "checker",
+            "output",
+        };
+
+        atomic<uint64_t> counters[COUNTER_COUNT];
+        atomic<uint64_t> timerCalls[TIMER_COUNT];
+        atomic<int64_t> timerNanoseconds[TIMER_COUNT];
+    }
+
+    namespace logic {
+        namespace stats {
+            void Add(Counter counter, uint64_t n) {
+                counters[counter].fetch_add(n, memory_order_relaxed);
+            }
+
+            void AddTime(Timer timer, chrono::steady_clock::duration d) {
+                timerCalls[timer].fetch_add(1, memory_order_relaxed);
+                timerNanoseconds[timer].fetch_add(
+                    chrono::duration_cast<chrono::nanoseconds>(d).count(), memory_order_relaxed
+                );
+            }
+
+            void WriteJson(ostream& os) {
+                os << "{\n  \"counters\": {";
+                for (int i = 0; i < COUNTER_COUNT; i++)
+                    os << (i ? ",\n" : "\n") << "    \"" << COUNTER_NAMES[i] << "\": "
+                        << counters[i];
+                os << "\n  },\n  \"timers\": {";
+                for (int i = 0; i < TIMER_COUNT; i++)
+                    os << (i ? ",\n" : "\n") << "    \"" << TIMER_NAMES[i] << "\": { \"calls\": "
+                        << timerCalls[i] << ", \"seconds\": " << timerNanoseconds[i] * 1e-9 << " }";
+                os << "\n  }\n}\n";
+            }
+
+            int CountingBuffer::overflow(int c) {
+                if (traits_type::eq_int_type(c, traits_type::eof()))
+                    return traits_type::not_eof(c);
+                Add(BYTES_WRITTEN);
+                return _target->sputc(traits_type::to_char_type(c));
+            }
+
+            streamsize CountingBuffer::xsputn(const char* s, streamsize n) {
+                n = _target->sputn(s, n);
+                Add(BYTES_WRITTEN, n);
+                return n;
+            }
+
+            int CountingBuffer::sync() {
+                return _target->pubsync();
+            }
+        }
+    }
+
+    void* operator new(size_t size) {
+        Add(ALLOCATIONS);
+        Add(ALLOCATED_BYTES, size);
+        if (auto p = malloc(size ? size : 1))
+            return p;
+        throw bad_alloc();
+    }
+
+    void operator delete(void* p) noexcept {
+        free(p);
+    }
+
+    void operator delete(void* p, size_t) noexcept {
+        free(p);
+    }
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+// Low-overhead instrumentation. Everything below except the enumerations is compiled out unless
+// the library and the program are built with `LOGIC_STATS` defined.
+
+#include <cstdint>
+
+namespace logic {
+    namespace stats {
+        enum Counter {
+            TOKENS,
+            CONST_NODES,
+            VARIABLE_NODES,
+            NOT_NODES,
+            AND_NODES,
+            OR_NODES,
+            XOR_NODES,
+            IMPLICATION_NODES,
+            EQUIVALENCE_NODES,
+            EVALUATIONS,
+            BITSLICED_EVALUATIONS,
+            ALLOCATIONS,
+            ALLOCATED_BYTES,
+            BYTES_WRITTEN,
+            COUNTER_COUNT
+        };
+
+        enum Timer {
+            LEXER,
+            PARSER,
+            DEPENDENCY_VISITOR,
+            SUBSET_VISITOR,
+            OP_COUNT_VISITOR,
+            EVALUATION,
+            CHECKER,
+            OUTPUT,
+            TIMER_COUNT
+        };
+    }
+}
+
+#ifdef LOGIC_STATS
+#   include <chrono>
+#   include <iostream>
+#   include <streambuf>
+
+    namespace logic {
+        namespace stats {
+            void Add(Counter, uint64_t = 1);
+            void AddTime(Timer, std::chrono::steady_clock::duration);
+            void WriteJson(std::ostream&);
+
+            class ScopedTimer {
+            public:
+                explicit ScopedTimer(Timer timer):
+                    _timer(timer), _start(std::chrono::steady_clock::now()) { }
+                ScopedTimer(const ScopedTimer&) = delete;
+                ~ScopedTimer() { AddTime(_timer, std::chrono::steady_clock::now() - _start); }
+
+            private:
+                Timer _timer;
+                std::chrono::steady_clock::time_point _start;
+            };
+
+            // Forwards everything to another buffer and counts the bytes in `BYTES_WRITTEN`.
+            class CountingBuffer: public std::streambuf {
+            public:
+                explicit CountingBuffer(std::streambuf* target): _target(target) { }
+
+            protected:
+                int overflow(int);
+                std::streamsize xsputn(const char*, std::streamsize);
+                int sync();
+
+            private:
+                std::streambuf* _target;
+            };
+        }
+    }
+
+#   define LOGIC_STATS_COUNT(counter, n) (::logic::stats::Add((counter), (n)))
+#   define LOGIC_STATS_TIME(timer) ::logic::stats::ScopedTimer _statsTimer((timer))
+#else
+#   define LOGIC_STATS_COUNT(counter, n) ((void)0)
+#   define LOGIC_STATS_TIME(timer) ((void)0)
+#endif
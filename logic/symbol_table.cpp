@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "symbol_table.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+    size_t Hash(const char* s, size_t size) {
+        uint64_t h = 0xCBF29CE484222325;
+        for (size_t i = 0; i < size; i++)
+            h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001B3;
+        return size_t(h);
+    }
+}
+
+namespace logic {
+    const SymbolId SymbolTable::NONE;
+
+    auto SymbolTable::GetDefault() -> SymbolTable& {
+        static SymbolTable table;
+        return table;
+    }
+
+    SymbolTable::SymbolTable(): _buckets(16, NONE) { }
+
+    auto SymbolTable::Intern(const char* name, size_t size) -> SymbolId {
+        auto hash = Hash(name, size);
+        lock_guard<mutex> lock(_mutex);
+        auto bucket = _Find(name, size, hash);
+        if (_buckets[bucket] != NONE)
+            return _buckets[bucket];
+        SymbolId id = _names.size();
+        _names.emplace_back(name, size);
+        _hashes.push_back(hash);
+        _buckets[bucket] = id;
+        if (_names.size() * 2 > _buckets.size())
+            _Grow();
+        return id;
+    }
+
+    auto SymbolTable::Intern(const string& name) -> SymbolId {
+        return Intern(name.data(), name.size());
+    }
+
+    auto SymbolTable::Find(const string& name) const -> SymbolId {
+        auto hash = Hash(name.data(), name.size());
+        lock_guard<mutex> lock(_mutex);
+        return _buckets[_Find(name.data(), name.size(), hash)];
+    }
+
+    auto SymbolTable::GetName(SymbolId id) const -> const string& {
+        // Names do not move when others are added, so the reference stays valid without the lock.
+        lock_guard<mutex> lock(_mutex);
+        return _names[id];
+    }
+
+    auto SymbolTable::GetSize() const -> size_t {
+        lock_guard<mutex> lock(_mutex);
+        return _names.size();
+    }
+
+    auto SymbolTable::GetNames(const vector<bool>& symbols) const -> vector<string> {
+        vector<string> result;
+        {
+            lock_guard<mutex> lock(_mutex);
+            for (size_t i = 0; i < symbols.size(); i++)
+                if (symbols[i])
+                    result.push_back(_names[i]);
+        }
+        sort(begin(result), end(result));
+        return result;
+    }
+
+    // Linear probing; returns the bucket holding the name or the empty one where it belongs.
+    auto SymbolTable::_Find(const char* name, size_t size, size_t hash) const -> size_t {
+        auto mask = _buckets.size() - 1;
+        for (auto i = hash & mask; ; i = (i + 1) & mask) {
+            auto id = _buckets[i];
+            if (id == NONE || (_hashes[id] == hash && _names[id].size() == size &&
+                    !memcmp(_names[id].data(), name, size)))
+                return i;
+        }
+    }
+
+    void SymbolTable::_Grow() {
+        _buckets.assign(_buckets.size() * 2, NONE);
+        auto mask = _buckets.size() - 1;
+        for (SymbolId id = 0; id < _names.size(); id++) {
+            auto i = _hashes[id] & mask;
+            while (_buckets[i] != NONE)
+                i = (i + 1) & mask;
+            _buckets[i] = id;
+        }
+    }
+
+    Context::Context(const map<string, bool>& values, const SymbolTable& symbols) {
+        for (const auto& value: values) {
+            auto id = symbols.Find(value.first);
+            if (id != SymbolTable::NONE)
+                Set(id, value.second);
+        }
+    }
+
+    void Context::Set(SymbolId id, bool value) {
+        if (id >= _values.size())
+            _values.resize(id + 1, -1);
+        _values[id] = value;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace logic {
+    using SymbolId = uint32_t;
+
+    // Interns identifiers and numbers them densely in the order of their first appearance. Names
+    // stay at the same address for the lifetime of the table, and symbols are never removed.
+    // All methods may be called from several threads at once.
+    class SymbolTable {
+    public:
+        static const SymbolId NONE = SymbolId(-1);
+
+        // The table used when none is given explicitly. It is shared by the whole process.
+        static auto GetDefault() -> SymbolTable&;
+
+        SymbolTable();
+        auto Intern(const char* name, size_t size) -> SymbolId;
+        auto Intern(const std::string&) -> SymbolId;
+        auto Find(const std::string&) const -> SymbolId;
+        auto GetName(SymbolId) const -> const std::string&;
+        auto GetSize() const -> size_t;
+        // Names of the symbols whose bits are set, sorted.
+        auto GetNames(const std::vector<bool>& symbols) const -> std::vector<std::string>;
+
+    private:
+        mutable std::mutex _mutex;
+        std::deque<std::string> _names;
+        std::vector<size_t> _hashes;
+        std::vector<SymbolId> _buckets;
+
+        auto _Find(const char* name, size_t size, size_t hash) const -> size_t;
+        void _Grow();
+    };
+
+    // Values of variables, indexed by their symbols.
+    class Context {
+    public:
+        Context() = default;
+        // Names missing from the table are ignored: no expression over it can refer to them.
+        Context(const std::map<std::string, bool>&, const SymbolTable& = SymbolTable::GetDefault());
+        void Set(SymbolId, bool);
+        // 1 or 0 if the variable is set, -1 otherwise.
+        int Get(SymbolId id) const { return id < _values.size() ? _values[id] : -1; }
+
+    private:
+        std::vector<signed char> _values;
+    };
+}
@@ -19,22 +19,30 @@
 
 #pragma once
 
+#include <memory>
+#include "symbol_table.h"
 #include "token_id.h"
 
 namespace logic {
+    /*interface*/ class Expression;
+
     struct Token {
         TokenId id;
         union {
             bool value;
             struct {
-                const char* identifier;
-                size_t size;
+                const SymbolTable* symbols;
+                SymbolId symbol;
             };
+            // Moved out by the parser.
+            std::unique_ptr<Expression>* subexpression;
         };
 
         explicit Token(TokenId id = TK_EOF): id(id) { }
         Token(TokenId id, bool value): id(id), value(value) { }
-        Token(TokenId id, const char* identifier, size_t size):
-            id(id), identifier(identifier), size(size) { }
+        Token(TokenId id, const SymbolTable* symbols, SymbolId symbol):
+            id(id), symbols(symbols), symbol(symbol) { }
+        explicit Token(std::unique_ptr<Expression>* subexpression):
+            id(TK_EXPRESSION), subexpression(subexpression) { }
     };
 }
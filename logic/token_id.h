@@ -34,5 +34,7 @@ namespace logic {
         TK_XOR = 8,
         TK_IMPLICATION = 9,
         TK_EQUIVALENCE = 10,
+        // Stands for an already parsed subexpression; never produced by the lexer.
+        TK_EXPRESSION = 11,
     };
 }
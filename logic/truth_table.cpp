@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include "truth_table.h"
+#include <algorithm>
+#include "exception.h"
+#include "program_visitor.h"
+
+using namespace std;
+
+namespace {
+    const uint64_t LANE_PATTERNS[ ] = {
+        0xAAAAAAAAAAAAAAAA,
+        0xCCCCCCCCCCCCCCCC,
+        0xF0F0F0F0F0F0F0F0,
+        0xFF00FF00FF00FF00,
+        0xFFFF0000FFFF0000,
+        0xFFFFFFFF00000000,
+    };
+}
+
+namespace logic {
+    TruthTable::Iterator::Iterator(const TruthTable* table, uint64_t index):
+        _table(table), _index(min(index, table->GetRowCount())) {
+        _Settle();
+    }
+
+    auto TruthTable::Iterator::operator*() -> const Row& {
+        _Load(_index >> 6);
+        auto n = _table->_variableCount;
+        auto lane = _index & 0x3F;
+        _row.index = _index;
+        _row.values.resize(n + _table->_columns.size());
+        for (size_t i = 0; i < n; i++)
+            _row.values[i] = _index >> (n - i - 1) & 0x1;
+        for (size_t j = 0; j < _table->_columns.size(); j++)
+            _row.values[n + j] = _slots[_table->_columns[j]] >> lane & 0x1;
+        return _row;
+    }
+
+    auto TruthTable::Iterator::operator->() -> const Row* {
+        return &**this;
+    }
+
+    auto TruthTable::Iterator::operator++() -> Iterator& {
+        _index++;
+        _Settle();
+        return *this;
+    }
+
+    uint64_t TruthTable::Iterator::GetIndex() const {
+        return _index;
+    }
+
+    bool TruthTable::Iterator::operator==(const Iterator& other) const {
+        return _index == other._index;
+    }
+
+    bool TruthTable::Iterator::operator!=(const Iterator& other) const {
+        return _index != other._index;
+    }
+
+    void TruthTable::Iterator::_Load(uint64_t block) {
+        if (block != _block) {
+            _selected = _table->_Evaluate(block, _slots);
+            _block = block;
+        }
+    }
+
+    // Moves `_index` forward to the nearest selected row (or to the end).
+    void TruthTable::Iterator::_Settle() {
+        if (_table->_filters.empty())
+            return;
+        auto rowCount = _table->GetRowCount();
+        while (_index < rowCount) {
+            _Load(_index >> 6);
+            auto rest = _selected >> (_index & 0x3F);
+            if (rest) {
+                while (!(rest & 0x1)) {
+                    rest >>= 1;
+                    _index++;
+                }
+                return;
+            }
+            _index = (_index | 0x3F) + 1;
+        }
+        _index = rowCount;
+    }
+
+    TruthTable::TruthTable(const vector<string>& variables,
+        const vector<const Expression*>& columns):
+        _variableCount(variables.size()) {
+        if (_variableCount >= 64)
+            throw TooManyVariablesError(_variableCount);
+        ProgramVisitor visitor(variables);
+        // Columns are usually subexpressions of the last one, which is then compiled only once.
+        for (auto it = columns.rbegin(); it != columns.rend(); ++it)
+            if (!visitor.HasSlot(*it))
+                (*it)->Traverse(&visitor);
+        for (auto e: columns)
+            _columns.push_back(visitor.GetSlot(e));
+        _program = visitor.GetResult();
+    }
+
+    size_t TruthTable::GetVariableCount() const {
+        return _variableCount;
+    }
+
+    size_t TruthTable::GetColumnCount() const {
+        return _columns.size();
+    }
+
+    uint64_t TruthTable::GetRowCount() const {
+        return uint64_t(1) << _variableCount;
+    }
+
+    auto TruthTable::Where(size_t column, bool value) const -> TruthTable {
+        auto result = *this;
+        result._filters.emplace_back(_columns.at(column), value);
+        return result;
+    }
+
+    auto TruthTable::begin() const -> Iterator {
+        return Iterator(this, 0);
+    }
+
+    auto TruthTable::end() const -> Iterator {
+        return Iterator(this, GetRowCount());
+    }
+
+    auto TruthTable::At(uint64_t index) const -> Iterator {
+        return Iterator(this, index);
+    }
+
+    uint64_t TruthTable::GetBlock(uint64_t block, uint64_t columns[ ]) const {
+        vector<uint64_t> slots;
+        auto selected = _Evaluate(block, slots);
+        // Past the last row nothing is evaluated and `slots` stays empty.
+        for (size_t j = 0; j < _columns.size(); j++)
+            columns[j] = selected ? slots[_columns[j]] & selected : 0;
+        return selected;
+    }
+
+    uint64_t TruthTable::_Evaluate(uint64_t block, vector<uint64_t>& slots) const {
+        auto n = _variableCount;
+        size_t low = min<size_t>(n, 6);
+        if (block >> (n - low))
+            return 0;
+        vector<uint64_t> vars(n);
+        for (size_t i = 0; i < low; i++)
+            vars[n - i - 1] = LANE_PATTERNS[i];
+        for (size_t i = low; i < n; i++)
+            vars[n - i - 1] = block >> (i - low) & 0x1 ? ~uint64_t(0) : 0;
+        slots.resize(_program.GetSize());
+        _program.Evaluate(vars.data(), slots.data());
+        uint64_t selected = n >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << n)) - 1;
+        for (const auto& filter: _filters)
+            selected &= filter.second ? slots[filter.first] : ~slots[filter.first];
+        return selected;
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 Nickolay Bukreyev
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bit_program.h"
+#include "expression.h"
+
+namespace logic {
+    // A lazily evaluated truth table. Row `r` assigns variable `i` the value of bit `n - i - 1`
+    // of `r` (so the rows go in lexicographic order); rows are evaluated 64 at a time, only when
+    // an iterator reaches them.
+    class TruthTable {
+    public:
+        struct Row {
+            uint64_t index;
+            // Values of the variables followed by values of the columns.
+            std::vector<bool> values;
+        };
+
+        class Iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Row;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Row*;
+            using reference = const Row&;
+
+            Iterator() = default;
+            Iterator(const TruthTable*, uint64_t index);
+            auto operator*() -> const Row&;
+            auto operator->() -> const Row*;
+            auto operator++() -> Iterator&;
+            uint64_t GetIndex() const;
+            bool operator==(const Iterator&) const;
+            bool operator!=(const Iterator&) const;
+
+        private:
+            const TruthTable* _table = nullptr;
+            uint64_t _index = 0;
+            uint64_t _block = UINT64_MAX;
+            uint64_t _selected = 0;
+            std::vector<uint64_t> _slots;
+            Row _row;
+
+            void _Load(uint64_t block);
+            void _Settle();
+        };
+
+        // Every column must be built of the given variables only.
+        TruthTable(const std::vector<std::string>& variables,
+            const std::vector<const Expression*>& columns);
+        size_t GetVariableCount() const;
+        size_t GetColumnCount() const;
+        uint64_t GetRowCount() const;
+
+        // Returns a copy of the table that skips the rows where `column` is not `value`.
+        auto Where(size_t column, bool value) const -> TruthTable;
+
+        auto begin() const -> Iterator;
+        auto end() const -> Iterator;
+        // Returns an iterator to the first (selected) row with index not less than `index`.
+        auto At(uint64_t index) const -> Iterator;
+
+        // Packed access to rows `[64 * block, 64 * block + 64)`: bit `k` of `columns[j]` is the
+        // value of column `j` in row `64 * block + k`. Returns the mask of the rows that exist and
+        // are selected by all the filters; blocks past the end of the table are all zeros.
+        uint64_t GetBlock(uint64_t block, uint64_t columns[ ]) const;
+
+    private:
+        size_t _variableCount;
+        BitProgram _program;
+        std::vector<size_t> _columns;
+        std::vector<std::pair<size_t, bool>> _filters;
+
+        uint64_t _Evaluate(uint64_t block, std::vector<uint64_t>& slots) const;
+    };
+}
@@ -1,13 +1,23 @@
 #include <algorithm>
-#include <bitset>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
-#include "gray/for_each.h"
+#include <vector>
+#include "logic/checker.h"
+#include "logic/exception.h"
 #include "logic/lexer.h"
+#include "logic/minimizer.h"
+#include "logic/parallel_parser.h"
 #include "logic/parser.h"
+#include "logic/profile.h"
+#include "logic/result_cache.h"
+#include "logic/sampler.h"
 #include "logic/dependency_visitor.h"
+#include "logic/stats.h"
 #include "logic/subset_visitor.h"
+#include "logic/truth_table.h"
 
 using namespace std;
 
@@ -26,44 +36,288 @@ private:
     size_t _count = 0;
 };
 
-int main() {
+unique_ptr<logic::Expression> ReadExpression(bool flatten = false) {
     string s;
     getline(cin, s);
-
-    unique_ptr<logic::Expression> expr;
     try {
         auto tokens = logic::Lexer(s.c_str(), s.length()).Tokenize();
-        expr = logic::Parser(tokens.data()).Parse(s.c_str());
+        return logic::ParallelParser(tokens, flatten).Parse(s.c_str());
     }
     catch (logic::LexicalError&) {
         cerr << "Lexical error\n";
-        return 1;
     }
     catch (logic::SyntaxError&) {
         cerr << "Syntax error\n";
+    }
+    return nullptr;
+}
+
+void PrintAssignment(const map<string, bool>& assignment) {
+    for (const auto& var: assignment)
+        cout << var.first << " = " << var.second << endl;
+}
+
+int CheckTautology() {
+    auto expr = ReadExpression(true);
+    if (!expr)
         return 1;
+    map<string, bool> counterexample;
+    try {
+        if (logic::CheckTautology(*expr, &counterexample)) {
+            cout << "Tautology\n";
+            return 0;
+        }
     }
+    catch (logic::TooManyVariablesError&) {
+        cerr << "Too many variables!\n";
+        return 1;
+    }
+    cout << "Not a tautology\n";
+    PrintAssignment(counterexample);
+    return 0;
+}
 
-    logic::DependencyVisitor dVisitor;
-    expr->Traverse(&dVisitor);
-    auto dependencySet = dVisitor.GetResult();
-    if (dependencySet.size() > MAX_VARIABLES) {
+int CheckEquivalent() {
+    auto a = ReadExpression(true);
+    if (!a)
+        return 1;
+    auto b = ReadExpression(true);
+    if (!b)
+        return 1;
+    map<string, bool> counterexample;
+    try {
+        if (logic::CheckEquivalent(*a, *b, &counterexample)) {
+            cout << "Equivalent\n";
+            return 0;
+        }
+    }
+    catch (logic::TooManyVariablesError&) {
+        cerr << "Too many variables!\n";
+        return 1;
+    }
+    cout << "Not equivalent\n";
+    PrintAssignment(counterexample);
+    return 0;
+}
+
+size_t CountOperations(const logic::Expression& e) {
+    OpCountVisitor visitor;
+    e.Traverse(&visitor);
+    return visitor.GetCount();
+}
+
+int Minimize() {
+    auto expr = ReadExpression();
+    if (!expr)
+        return 1;
+    try {
+        logic::Minimizer minimizer(*expr);
+        auto dnf = minimizer.GetDnf(), cnf = minimizer.GetCnf();
+        cout << "Original (" << CountOperations(*expr) << " operations): ";
+        expr->ToString(cout);
+        cout << "\nDNF (" << CountOperations(*dnf) << " operations): ";
+        dnf->ToString(cout);
+        cout << "\nCNF (" << CountOperations(*cnf) << " operations): ";
+        cnf->ToString(cout);
+        cout << endl;
+        if (!minimizer.IsExact())
+            cout << "(heuristic, not proven minimal)\n";
+    }
+    catch (logic::TooManyVariablesError&) {
         cerr << "Too many variables!\n";
         return 1;
     }
-    vector<string> deps(dependencySet.rbegin(), dependencySet.rend());
+    return 0;
+}
 
+vector<const logic::Expression*> CollectOperators(const logic::Expression& expr) {
     logic::SubsetVisitor sVisitor;
-    expr->Traverse(&sVisitor);
+    {
+        LOGIC_STATS_TIME(logic::stats::SUBSET_VISITOR);
+        expr.Traverse(&sVisitor);
+    }
     auto subsets = sVisitor.GetResult();
     subsets.erase(remove_if(begin(subsets), end(subsets),
         [ ](const logic::Expression* e) {
             return !dynamic_cast<const logic::Operator*>(e);
         }
     ), end(subsets));
+    return subsets;
+}
+
+int Sample(uint64_t samples, uint64_t seed, const map<string, double>& biases) {
+    auto expr = ReadExpression(true);
+    if (!expr)
+        return 1;
+
+    logic::DependencyVisitor dVisitor;
+    {
+        LOGIC_STATS_TIME(logic::stats::DEPENDENCY_VISITOR);
+        expr->Traverse(&dVisitor);
+    }
+    auto deps = dVisitor.GetNames();
+    auto subsets = CollectOperators(*expr);
+    if (subsets.empty())
+        subsets.push_back(expr.get());
+
+    logic::Sampler sampler(deps, subsets);
+    for (const auto& bias: biases) {
+        auto it = lower_bound(begin(deps), end(deps), bias.first);
+        if (it == end(deps) || *it != bias.first) {
+            cerr << "Unknown variable: " << bias.first << endl;
+            return 1;
+        }
+        sampler.SetBias(it - begin(deps), bias.second);
+    }
+    auto estimates = sampler.Run(samples, seed);
+
+    cout << deps.size() << " variables, " << samples << " samples, seed " << seed << "\n\n";
+    cout << "F\tP\t95% CI\tExpression\n";
+    LOGIC_STATS_TIME(logic::stats::OUTPUT);
+    for (size_t i = 0; i < subsets.size(); i++) {
+        const auto& e = estimates[i];
+        cout << 'F' << i + 1 << '\t' << e.probability << "\t[" << e.low << ", " << e.high << "]\t";
+        subsets[i]->ToString(cout);
+        cout << endl;
+    }
+    return 0;
+}
+
+// Prints the same rows as iterating over a `logic::TruthTable` of the expression would.
+void PrintCachedRows(const logic::ResultCache::Entry& entry, uint64_t first, uint64_t last) {
+    auto n = entry.GetVariableCount();
+    vector<uint64_t> columns(entry.GetColumnCount());
+    string line;
+    for (auto row = first; row < last; row++) {
+        if (row == first || !(row & 63))
+            entry.GetBlock(row >> 6, columns.data());
+        line.clear();
+        for (size_t i = 0; i < n; i++) {
+            line += char('0' + (row >> (n - i - 1) & 0x1));
+            line += '\t';
+        }
+        for (auto x: columns) {
+            line += char('0' + (x >> (row & 63) & 0x1));
+            line += '\t';
+        }
+        line += '\n';
+        cout << line;
+    }
+}
+
+int Specialize(const map<string, bool>& values) {
+    auto expr = ReadExpression();
+    if (!expr)
+        return 1;
+    expr->Specialize(logic::Context(values))->ToString(cout);
+    cout << endl;
+    return 0;
+}
+
+// Reads assignments (one per line, the values of the variables in the order of their names, like
+// rows of the truth table) up to the end of the input and records them in the profile, which keeps
+// a uniform sample of at most `logic::Profile::DEFAULT_MAX_ASSIGNMENTS` of all the ones recorded.
+int RecordProfile(const string& fileName) {
+    auto expr = ReadExpression();
+    if (!expr)
+        return 1;
+    logic::DependencyVisitor dVisitor;
+    expr->Traverse(&dVisitor);
+    auto deps = dVisitor.GetNames();
+
+    vector<vector<bool>> assignments;
+    string line;
+    for (size_t n = 2; getline(cin, line); n++) {
+        vector<bool> assignment;
+        for (char c: line)
+            if (c == '0' || c == '1')
+                assignment.push_back(c == '1');
+        if (assignment.size() != deps.size() || line.find_first_not_of("01 \t") != string::npos) {
+            cerr << "Malformed assignment on line " << n << endl;
+            return 1;
+        }
+        assignments.push_back(move(assignment));
+    }
+
+    logic::Profile profile;
+    try {
+        ifstream in(fileName);
+        if (in)
+            profile.Load(in);
+    }
+    catch (logic::ProfileFormatError& e) {
+        cerr << fileName << ": " << e.what() << endl;
+        return 1;
+    }
+    profile.Record(deps, assignments);
+    ofstream out(fileName);
+    profile.Save(out);
+    if (!out.flush()) {
+        cerr << fileName << ": cannot write the profile\n";
+        return 1;
+    }
+    cout << assignments.size() << " assignments recorded, " << profile.GetAssignmentCount() <<
+        " of " << profile.GetRecordedCount() << " kept in the profile\n";
+    return 0;
+}
+
+int Reorder(const string& fileName) {
+    auto expr = ReadExpression();
+    if (!expr)
+        return 1;
+    logic::Profile profile;
+    ifstream in(fileName);
+    if (!in) {
+        cerr << fileName << ": cannot read the profile\n";
+        return 1;
+    }
+    try {
+        profile.Load(in);
+    }
+    catch (logic::ProfileFormatError& e) {
+        cerr << fileName << ": " << e.what() << endl;
+        return 1;
+    }
+    auto cost = logic::ReorderOperands(*expr, profile);
+    if (!cost.before) {
+        cerr << fileName << ": no assignment gives values to all the variables\n";
+        return 1;
+    }
+    expr->ToString(cout);
+    cout << "\nMeasured cost: " << cost.before << " -> " << cost.after <<
+        " evaluations per assignment (" << cost.before / cost.after << "x faster)\n";
+    return 0;
+}
+
+// Shard `shard` out of `shardCount` gets a contiguous range of rows. A shard's output is framed so
+// that `MergeShards` can stitch the shards into exactly what a single process prints. Shards only
+// read the cache: filling it takes the whole table.
+int PrintTruthTable(size_t shard = 0, size_t shardCount = 0,
+    const logic::ResultCache* cache = nullptr) {
+    auto expr = ReadExpression();
+    if (!expr)
+        return 1;
+
+    logic::DependencyVisitor dVisitor;
+    {
+        LOGIC_STATS_TIME(logic::stats::DEPENDENCY_VISITOR);
+        expr->Traverse(&dVisitor);
+    }
+    auto deps = dVisitor.GetNames();
+    if (deps.size() > MAX_VARIABLES) {
+        cerr << "Too many variables!\n";
+        return 1;
+    }
+
+    auto subsets = CollectOperators(*expr);
 
     OpCountVisitor cVisitor;
-    expr->Traverse(&cVisitor);
+    {
+        LOGIC_STATS_TIME(logic::stats::OP_COUNT_VISITOR);
+        expr->Traverse(&cVisitor);
+    }
+    if (shardCount)
+        cout << "#shard " << shard << '/' << shardCount << endl;
     cout << endl << cVisitor.GetCount() << " operations\n";
 
     for (size_t i = 0; i < subsets.size(); i++) {
@@ -73,38 +327,213 @@ int main() {
     }
     cout << endl;
 
-    vector<vector<bool>> table(
-        1LL << deps.size(),
-        vector<bool>(deps.size() + subsets.size())
-    );
-    map<string, bool> context;
     for (const string& var: deps)
-        context.emplace(var, 0);
-    bitset<MAX_VARIABLES> mask;
-    gray::ForEach(deps.size(),
-        [&](int bit) {
-            if (bit != -1) {
-                mask.flip(bit);
-                context.find(deps[bit])->second ^= true;
-            }
-            auto pos = mask.to_ulong();
-            size_t i;
-            for (i = 0; i < deps.size(); i++)
-                table[pos][i] = mask[deps.size() - i - 1];
-            for (auto e: subsets)
-                table[pos][i++] = e->Evaluate(context);
-        }
-    );
-
-    for_each(deps.rbegin(), deps.rend(),
-        [ ](const string& var) { cout << var << '\t'; }
-    );
+        cout << var << '\t';
     for (size_t i = 1; i <= subsets.size(); i++)
         cout << 'F' << i << '\t';
     cout << endl;
-    for (const auto& row: table) {
-        for (auto b: row)
-            cout << b << '\t';
-        cout << endl;
+    if (shardCount)
+        cout << "#rows\n";
+
+    unique_ptr<logic::ResultCache::Entry> entry;
+    if (cache) {
+        entry = cache->Find(*expr);
+        if (!entry && !shardCount && cache->Store(*expr))
+            entry = cache->Find(*expr);
     }
+
+    uint64_t rowCount = uint64_t(1) << deps.size();
+    uint64_t first = 0, last = rowCount;
+    if (shardCount) {
+        first = rowCount * shard / shardCount;
+        last = rowCount * (shard + 1) / shardCount;
+    }
+    LOGIC_STATS_TIME(logic::stats::OUTPUT);
+    if (entry) {
+        PrintCachedRows(*entry, first, last);
+        return 0;
+    }
+    logic::TruthTable table(deps, subsets);
+    {
+        // Rows are evaluated as they are printed, so this includes writing them.
+        LOGIC_STATS_TIME(logic::stats::EVALUATION);
+        for (auto it = table.At(first), stop = table.At(last); it != stop; ++it) {
+            for (auto b: it->values)
+                cout << b << '\t';
+            cout << endl;
+        }
+    }
+    return 0;
+}
+
+struct Shard {
+    unique_ptr<ifstream> file;
+    string preamble;
+    size_t count = 0;
+};
+
+int MergeShards(const vector<string>& fileNames) {
+    vector<Shard> shards;
+    for (const auto& name: fileNames) {
+        Shard shard;
+        shard.file.reset(new ifstream(name, ios::binary));
+        string line;
+        size_t index = 0;
+        char slash = 0;
+        if (getline(*shard.file, line) && line.compare(0, 7, "#shard ") == 0)
+            istringstream(line.substr(7)) >> index >> slash >> shard.count;
+        if (slash != '/' || index >= shard.count) {
+            cerr << name << ": not a shard\n";
+            return 1;
+        }
+        while (getline(*shard.file, line) && line != "#rows")
+            shard.preamble += line + '\n';
+        if (!*shard.file) {
+            cerr << name << ": truncated shard\n";
+            return 1;
+        }
+        if (shards.empty())
+            shards.resize(shard.count);
+        if (shard.count != shards.size() || shards[index].file) {
+            cerr << name << ": shard does not match the others\n";
+            return 1;
+        }
+        shards[index] = move(shard);
+    }
+    for (size_t i = 0; i < shards.size(); i++)
+        if (!shards[i].file || shards[i].preamble != shards[0].preamble) {
+            cerr << "Shard " << i
+                << (shards[i].file ? " does not match the others\n" : " is missing\n");
+            return 1;
+        }
+
+    if (shards.empty())
+        return 0;
+    cout << shards[0].preamble;
+    for (auto& shard: shards)
+        if (shard.file->peek() != EOF)
+            cout << shard.file->rdbuf();
+    return 0;
+}
+
+bool ParseBias(const string& arg, map<string, double>* biases) {
+    auto eq = arg.find('=');
+    if (eq == string::npos || !eq)
+        return false;
+    istringstream in(arg.substr(eq + 1));
+    double p;
+    if (!(in >> p) || !in.eof() || !(p >= 0 && p <= 1))
+        return false;
+    (*biases)[arg.substr(0, eq)] = p;
+    return true;
+}
+
+bool ParseValue(const string& arg, map<string, bool>* values) {
+    auto eq = arg.find('=');
+    if (eq == string::npos || !eq || eq + 2 != arg.size())
+        return false;
+    if (arg[eq + 1] != '0' && arg[eq + 1] != '1')
+        return false;
+    (*values)[arg.substr(0, eq)] = arg[eq + 1] == '1';
+    return true;
+}
+
+int main(int argc, char* argv[ ]) {
+    string mode;
+    bool stats = false;
+    size_t shard = 0, shardCount = 0;
+    vector<string> mergedFiles;
+    uint64_t samples = 0, seed = 1;
+    bool seeded = false;
+    map<string, double> biases;
+    map<string, bool> values;
+    string cacheDirectory, profileFile;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        char slash = 0;
+        if (arg == "--stats")
+            stats = true;
+        else if (mode == "--merge")
+            mergedFiles.push_back(arg);
+        else if (mode.empty() &&
+                (arg == "--tautology" || arg == "--equivalent" || arg == "--minimize"))
+            mode = arg;
+        else if (mode.empty() && arg == "--shard" && i + 1 < argc &&
+                (istringstream(argv[++i]) >> shard >> slash >> shardCount) &&
+                slash == '/' && shard < shardCount)
+            mode = arg;
+        else if (mode.empty() && (arg == "--merge" || arg == "--specialize"))
+            mode = arg;
+        else if (mode == "--specialize" && ParseValue(arg, &values))
+            continue;
+        else if (mode.empty() && (arg == "--profile" || arg == "--reorder") && i + 1 < argc) {
+            mode = arg;
+            profileFile = argv[++i];
+        }
+        else if (mode.empty() && arg == "--sample" && i + 1 < argc &&
+                (istringstream(argv[++i]) >> samples) && samples)
+            mode = arg;
+        else if (!seeded && arg == "--seed" && i + 1 < argc && (istringstream(argv[++i]) >> seed))
+            seeded = true;
+        else if (arg == "--bias" && i + 1 < argc && ParseBias(argv[++i], &biases))
+            continue;
+        else if (cacheDirectory.empty() && arg == "--cache" && i + 1 < argc && *argv[i + 1])
+            cacheDirectory = argv[++i];
+        else {
+            cerr << "Usage: " << argv[0] <<
+                " [--tautology | --equivalent | --minimize | --shard I/N | --merge SHARD... |\n"
+                "    --sample N [--seed S] [--bias VAR=P]... | --profile FILE | --reorder FILE |\n"
+                "    --specialize VAR=0|1...] [--cache DIR] [--stats]\n";
+            return 1;
+        }
+    }
+    if ((seeded || !biases.empty()) && mode != "--sample") {
+        cerr << "--seed and --bias require --sample\n";
+        return 1;
+    }
+    if (!cacheDirectory.empty() && !mode.empty() && mode != "--shard") {
+        cerr << "--cache only applies to truth tables\n";
+        return 1;
+    }
+#ifdef LOGIC_STATS
+    logic::stats::CountingBuffer countingBuffer(cout.rdbuf());
+    auto originalBuffer = cout.rdbuf(&countingBuffer);
+#else
+    if (stats) {
+        cerr << "Statistics are not available (the program is built without LOGIC_STATS)\n";
+        return 1;
+    }
+#endif
+
+    int status;
+    if (mode == "--tautology")
+        status = CheckTautology();
+    else if (mode == "--equivalent")
+        status = CheckEquivalent();
+    else if (mode == "--minimize")
+        status = Minimize();
+    else if (mode == "--merge")
+        status = MergeShards(mergedFiles);
+    else if (mode == "--sample")
+        status = Sample(samples, seed, biases);
+    else if (mode == "--specialize")
+        status = Specialize(values);
+    else if (mode == "--profile")
+        status = RecordProfile(profileFile);
+    else if (mode == "--reorder")
+        status = Reorder(profileFile);
+    else if (!cacheDirectory.empty()) {
+        logic::ResultCache cache(cacheDirectory);
+        status = PrintTruthTable(shard, shardCount, &cache);
+    }
+    else
+        status = PrintTruthTable(shard, shardCount);
+
+#ifdef LOGIC_STATS
+    cout.flush();
+    cout.rdbuf(originalBuffer);
+    if (stats)
+        logic::stats::WriteJson(cerr);
+#endif
+    return status;
 }